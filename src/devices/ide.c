@@ -9,6 +9,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -71,6 +72,7 @@ struct channel
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct work unexpected_work;        /* Reports a spurious interrupt. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
@@ -96,6 +98,7 @@ static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static work_func report_unexpected;
 
 /* Initialize the disk subsystem and detect disks. */
 void
@@ -126,6 +129,7 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      work_init (&c->unexpected_work, report_unexpected, c);
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -517,11 +521,25 @@ interrupt_handler (struct intr_frame *f)
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
-          printf ("%s: unexpected interrupt\n", c->name);
+          {
+            /* Printing is slow, so leave it until interrupts are
+               back on. */
+            work_queue (system_wq, &c->unexpected_work);
+          }
         return;
       }
 
   NOT_REACHED ();
 }
 
+/* Reports an unexpected interrupt on channel C_.  Runs in a work
+   queue on behalf of interrupt_handler(). */
+static void
+report_unexpected (void *c_)
+{
+  struct channel *c = c_;
+
+  printf ("%s: unexpected interrupt\n", c->name);
+}
+
 
@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,48 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts a one-shot countdown of COUNT PIT cycles on CHANNEL,
+   using mode 0 ("interrupt on terminal count"): the channel's
+   output goes from 0 to 1 once COUNT cycles have passed, which
+   raises a single interrupt on channel 0, and then stays at 1
+   until the channel is reprogrammed.  A COUNT of 0 is treated
+   as 65536. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's counter.  If OUTPUT is
+   nonnull, also stores the state of the channel's output into
+   *OUTPUT, which after pit_start_oneshot() tells whether the
+   countdown has finished.  Uses the 8254 read-back command, so
+   that count and status are latched at the same instant. */
+uint16_t
+pit_read_counter (int channel, bool *output)
+{
+  enum intr_level old_level;
+  uint8_t status, lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  if (output != NULL)
+    *output = (status & 0x80) != 0;
+  return lo | (hi << 8);
+}
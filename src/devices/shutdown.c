@@ -4,8 +4,14 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/fpu.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -95,6 +101,7 @@ shutdown_power_off (void)
 #endif
 
   print_stats ();
+  trace_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -120,6 +127,11 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  malloc_print_stats ();
+  fpu_print_stats ();
+  palloc_print_stats ();
+  kmem_cache_print_stats ();
+  workqueue_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -1,5 +1,4 @@
 #include "devices/timer.h"
-#include <float.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
@@ -8,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -21,56 +21,149 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
+/* Time-stamp counter frequency, in cycles per second.
    Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+static uint64_t tsc_hz;
+
+/* Time-stamp counter value when the timer was initialized. */
+static uint64_t tsc_boot;
+
+/* Number of timer ticks to calibrate the time-stamp counter
+   over. */
+#define CALIBRATE_TICKS 8
+
+#define NSEC_PER_SEC 1000000000LL
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
+static uint64_t ns_to_cycles (int64_t ns);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-/* List of sleeping threads. */
-static struct list timer_list;
-
-static int counter = 0;
+/* A thread in a sub-tick sleep, which ends between two timer
+   ticks. */
+struct hr_sleeper
+  {
+    struct list_elem elem;      /* Element in hr_sleepers. */
+    uint64_t wakeup;            /* Time-stamp counter to wake up at. */
+    struct thread *thread;      /* Sleeping thread. */
+  };
+
+/* Sub-tick sleepers, in order of wakeup time.  There are rarely
+   more than a few. */
+static struct list hr_sleepers;
+
+/* Sub-tick sleeps shorter than this busy-wait instead, because
+   blocking and waking up would take longer. */
+#define HR_SLEEP_MIN_NS 100000
+
+static void hr_sleep (int64_t ns);
+static void hr_wake (void);
+
+/* Hierarchical timing wheel holding pending kernel timers.
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each slot at level L spans WHEEL_SIZE^L ticks, so the wheel
+   covers WHEEL_SIZE^WHEEL_LEVELS ticks in all.  Adding or
+   cancelling a timer is a constant-time list operation.  Each
+   time level 0 wraps around, the next slot of level 1 is emptied
+   and its timers are redistributed into level 0, and so on up
+   the levels, so every timer is moved at most WHEEL_LEVELS - 1
+   times before it fires. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 5
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick whose timers have not yet been run. */
+static int64_t wheel_ticks;
+
+static void wheel_insert (struct timer_elem *);
+static bool wheel_cascade (int level);
+static void wheel_advance (void);
+static int wheel_next_event (int max_ticks);
+
+/* Timer interrupt programming.
+
+   Normally the 8254 interrupts once per tick, in periodic mode.
+   It is switched to one-shot mode when an interrupt is needed
+   between two ticks, to end a sub-tick sleep, and in tickless
+   mode when only the idle thread can run.  Then the interrupt is
+   put off to the next tick at which the timing wheel has timers
+   to run or a level to cascade, and the ticks skipped are caught
+   up as idle ticks when it arrives, or when another interrupt
+   wakes a thread before then.  The 8254's 16-bit counter limits
+   a one-shot to 65535 PIT cycles, about 5 ticks at 100 Hz.
+
+   While a one-shot is running, tick boundaries fall at
+   oneshot_first + N * PIT_TICK_COUNT PIT cycles after it
+   started, which lets ticks be counted exactly when it ends. */
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* If true, stop the periodic tick while idle.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+static bool oneshot;            /* True if in one-shot mode. */
+static uint16_t oneshot_count;  /* PIT cycles the one-shot started with. */
+static uint16_t oneshot_first;  /* PIT cycles to its first tick boundary. */
+static int missed_ticks;        /* Skipped ticks not yet caught up. */
+static int64_t elided_ticks;    /* Timer interrupts avoided so far. */
+
+/* Most cycles spent in one run of the timer interrupt handler,
+   and the total cycles and number of runs, since boot or
+   timer_reset_max_interrupt(). */
+static uint64_t max_interrupt_cycles;
+static uint64_t interrupt_cycles;
+static unsigned interrupt_cnt;
+
+static int oneshot_ticks_crossed (uint16_t elapsed);
+static uint16_t oneshot_stop (void);
+static bool clock_wants_oneshot (void);
+static void clock_program (uint16_t to_tick, bool periodic);
+static void timer_tick (bool idle);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void)
 {
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_ticks = 0;
+  list_init (&hr_sleepers);
+  tsc_boot = timer_cycles ();
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init (&timer_list);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the time-stamp counter against the timer
+   interrupt, for timer_ns() and for brief delays. */
 void
 timer_calibrate (void)
 {
-  unsigned high_bit, test_bit;
+  int64_t start;
+  uint64_t tsc_start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1))
-    {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
-    }
-
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  /* Count cycles across CALIBRATE_TICKS whole ticks, starting
+     right at a tick. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  start = ticks;
+  tsc_start = timer_cycles ();
+  while (ticks - start < CALIBRATE_TICKS)
+    barrier ();
+  tsc_hz = (timer_cycles () - tsc_start) * TIMER_FREQ / CALIBRATE_TICKS;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" cycles/s.\n", tsc_hz);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -91,13 +184,101 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-/* Comparing list elements. */
-static bool end_time_less (const struct list_elem *a, const struct list_elem *b, void *aux)
+/* Returns the CPU's time-stamp counter, which counts clock
+   cycles since the CPU was reset. */
+uint64_t
+timer_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Converts CYCLES time-stamp counter cycles into nanoseconds.
+   Returns 0 before the timer has been calibrated. */
+int64_t
+timer_cycles_to_ns (uint64_t cycles)
+{
+  if (tsc_hz == 0)
+    return 0;
+  return (cycles / tsc_hz * NSEC_PER_SEC
+          + cycles % tsc_hz * NSEC_PER_SEC / tsc_hz);
+}
+
+/* Returns the number of nanoseconds since the OS booted,
+   according to the time-stamp counter.  Unlike timer_ticks(),
+   this is monotonic at the resolution of a CPU cycle.  Returns 0
+   before the timer has been calibrated. */
+int64_t
+timer_ns (void)
+{
+  return timer_cycles_to_ns (timer_cycles () - tsc_boot);
+}
+
+/* Converts NS nanoseconds into time-stamp counter cycles. */
+static uint64_t
+ns_to_cycles (int64_t ns)
 {
-  struct timer_elem *e1 = list_entry (a, struct timer_elem, elem);
-  struct timer_elem *e2 = list_entry (b, struct timer_elem, elem);
+  if (ns <= 0)
+    return 0;
+  return (ns / NSEC_PER_SEC * tsc_hz
+          + ns % NSEC_PER_SEC * tsc_hz / NSEC_PER_SEC);
+}
+
+/* Arms timer T to call FUNC, passing AUX, from the timer
+   interrupt handler once timer_ticks() reaches WHEN.  If WHEN
+   has already passed, T fires on the next tick.  T must not
+   already be pending.
+
+   This function may be called from an interrupt handler. */
+void
+timer_add (struct timer_elem *t, int64_t when, timer_func *func, void *aux)
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!t->pending);
+  t->end_time = when;
+  t->func = func;
+  t->aux = aux;
+  t->pending = true;
+  wheel_insert (t);
+  intr_set_level (old_level);
+}
+
+/* Cancels timer T.  Returns true if T was pending, false if it
+   had already fired or was never armed.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_cancel (struct timer_elem *t)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (t != NULL);
 
-  return e1->end_time < e2->end_time;
+  old_level = intr_disable ();
+  was_pending = t->pending;
+  if (was_pending)
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Timer function used by timer_sleep() to wake up the sleeping
+   thread. */
+static void
+wake_thread (void *t)
+{
+  thread_unblock (t);
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
@@ -110,11 +291,13 @@ timer_sleep (int64_t ticks)
 
   ASSERT (intr_get_level () == INTR_ON);
 
-  /* Add thread to a list with its end time and block it. */
+  if (ticks <= 0)
+    return;
+
+  /* Arm a timer to wake us up and block until it fires. */
   old_level = intr_disable ();
-	element.thread = thread_current ();
-  element.end_time = timer_ticks () + ticks;
-  list_insert_ordered (&timer_list, &element.elem, end_time_less, NULL);
+  element.pending = false;
+  timer_add (&element, timer_ticks () + ticks, wake_thread, thread_current ());
   thread_block ();
   intr_set_level (old_level);
 }
@@ -186,113 +369,336 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void)
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" ticks, %"PRId64" elided\n",
+            timer_ticks (), elided_ticks);
+  else
+    printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
-/* Calculates recent_cpu according to this formula:
-   recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice */
-static void
-calc_recent_cpu(struct thread *t, void *aux UNUSED) {
-	struct float32 real = multiply_int(thread_get_real_load_avg (), 2);
-	int recent_cpu = to_int(add_int(multiply_int(divide(real, add_int(real, 1)), t->recent_cpu), t->nice), true);
-  t->recent_cpu = recent_cpu;
+/* Returns the longest time, in nanoseconds, that the timer
+   interrupt handler has taken since boot or the last call to
+   timer_reset_max_interrupt(). */
+int64_t
+timer_max_interrupt_ns (void)
+{
+  return timer_cycles_to_ns (max_interrupt_cycles);
 }
 
-/* Calculates priority according to this formula:
-   priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
-static void
-calc_priority(struct thread *t, void *aux UNUSED) {
+/* Returns the mean time, in nanoseconds, that the timer
+   interrupt handler has taken since boot or the last call to
+   timer_reset_max_interrupt(), or 0 if it has not run. */
+int64_t
+timer_mean_interrupt_ns (void)
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t cycles = interrupt_cycles;
+  unsigned cnt = interrupt_cnt;
+  intr_set_level (old_level);
+
+  return cnt > 0 ? timer_cycles_to_ns (cycles / cnt) : 0;
+}
 
-	struct float32 real = to_float(t->recent_cpu);
-	struct float32 real4 = to_float(4);
-	real = divide(real, real4);
-	int calc_p = to_int(multiply_int((subtract_int(add_int(real, t->nice * 2), PRI_MAX)), -1), false);
-  t->priority = calc_p;
+/* Resets the longest and mean timer interrupt handler times. */
+void
+timer_reset_max_interrupt (void)
+{
+  enum intr_level old_level = intr_disable ();
+  max_interrupt_cycles = 0;
+  interrupt_cycles = 0;
+  interrupt_cnt = 0;
+  intr_set_level (old_level);
+}
+
+/* Called by the idle thread, with interrupts off, each time it
+   wakes up.  If a thread has become ready to run while the timer
+   was stopped for tickless idle, accounts for the ticks that
+   have passed and resumes the timer tick, so that the thread is
+   time-sliced normally. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot && ready_queue_length () != 0)
+    clock_program (oneshot_stop (), false);
 }
 
-
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick ();
+  uint64_t start = timer_cycles ();
+  uint64_t cycles;
+  int tick_cnt = 1;
+  uint16_t to_tick = 0;
+  bool periodic = true;
 
-  /* Wakes up sleeping threads whose time has passed. */
-  while (!list_empty(&timer_list))
-  {
-    struct timer_elem *element = list_entry (list_front(&timer_list), struct timer_elem, elem);
-    if (ticks >= element->end_time)
+  if (oneshot)
     {
-       thread_unblock (element->thread);
-       list_pop_front(&timer_list);
+      bool expired;
+
+      pit_read_counter (0, &expired);
+      if (expired)
+        {
+          tick_cnt = oneshot_ticks_crossed (oneshot_count);
+          to_tick = (oneshot_first + tick_cnt * PIT_TICK_COUNT
+                     - oneshot_count);
+          oneshot = false;
+          periodic = false;
+        }
+      /* Otherwise this is a periodic tick that was already pending
+         when the one-shot was started.  The one-shot's tick
+         boundaries were measured from after this tick, so count it
+         and leave the one-shot running. */
     }
-    else {
-      break;
+
+  /* Catch up on skipped ticks, charging all but the one that
+     just ended to the idle thread. */
+  if (tick_cnt > 0)
+    {
+      int idle_cnt = missed_ticks + tick_cnt - 1;
+
+      missed_ticks = 0;
+      elided_ticks += idle_cnt;
+      while (idle_cnt-- > 0)
+        timer_tick (true);
+      timer_tick (false);
     }
-  }
+
+  hr_wake ();
+
+  if (!periodic)
+    clock_program (to_tick, false);
+  else if (!oneshot && clock_wants_oneshot ())
+    clock_program (pit_read_counter (0, NULL), true);
+
+  cycles = timer_cycles () - start;
+  if (cycles > max_interrupt_cycles)
+    max_interrupt_cycles = cycles;
+  interrupt_cycles += cycles;
+  interrupt_cnt++;
+}
+
+/* Does the work for a single timer tick.  If IDLE is true, the
+   tick was skipped by tickless idle, so there is no running
+   thread to tick. */
+static void
+timer_tick (bool idle)
+{
+  ticks++;
+  if (!idle)
+    thread_tick ();
+
+  /* Runs timers, including those of sleeping threads, whose time
+     has come. */
+  while (wheel_ticks <= ticks)
+    wheel_advance ();
 
   if (thread_mlfqs)
-  {
-    struct float32 real;
-    struct float32 real60 = to_float(60);
-    struct float32 real59 = to_float(59);
-    struct float32 real1 = to_float(1);
+    thread_mlfqs_tick (ticks);
+}
+
+/* Returns the number of tick boundaries that fall within the
+   first ELAPSED PIT cycles of the running one-shot. */
+static int
+oneshot_ticks_crossed (uint16_t elapsed)
+{
+  if (elapsed < oneshot_first)
+    return 0;
+  return 1 + (elapsed - oneshot_first) / PIT_TICK_COUNT;
+}
+
+/* Stops the running one-shot before it fires and returns the
+   number of PIT cycles to the next tick boundary.  Tick
+   boundaries already passed are recorded in missed_ticks.  If
+   the one-shot has already fired, leaves it to the pending
+   interrupt and returns 0.  Interrupts must be off. */
+static uint16_t
+oneshot_stop (void)
+{
+  uint16_t elapsed;
+  bool expired;
+  int crossed;
+
+  ASSERT (oneshot);
+
+  elapsed = oneshot_count - pit_read_counter (0, &expired);
+  if (expired)
+    return 0;
+
+  crossed = oneshot_ticks_crossed (elapsed);
+  missed_ticks += crossed;
+  oneshot = false;
+  return oneshot_first + crossed * PIT_TICK_COUNT - elapsed;
+}
+
+/* Returns true if the next timer interrupt might need to come
+   at some other time than the next tick. */
+static bool
+clock_wants_oneshot (void)
+{
+  return (!list_empty (&hr_sleepers)
+          || (timer_tickless
+              && is_idle_thread (thread_current ())
+              && ready_queue_length () == 0));
+}
+
+/* Programs the 8254 for the next timer interrupt, given that the
+   next tick boundary is TO_TICK PIT cycles away.  If PERIODIC,
+   the 8254 is in periodic mode, otherwise it is stopped.  A
+   TO_TICK of 0 means that an interrupt is already pending, so
+   there is nothing to do.  Interrupts must be off. */
+static void
+clock_program (uint16_t to_tick, bool periodic)
+{
+  uint32_t count = to_tick;
 
-    if(timer_ticks () % TIMER_FREQ == 0)
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (to_tick == 0)
+    return;
+
+  /* In tickless idle, skip ahead to the next tick with work. */
+  if (timer_tickless && is_idle_thread (thread_current ())
+      && ready_queue_length () == 0)
+    {
+      int n = wheel_next_event (1 + (65535 - to_tick) / PIT_TICK_COUNT);
+      count = to_tick + (n - 1) * PIT_TICK_COUNT;
+    }
+
+  /* Wake up the first sub-tick sleeper on time. */
+  if (!list_empty (&hr_sleepers))
     {
-      /* Calculates load_avg according to this formula:
-         load_avg = (59/60)*load_avg + (1/60)*ready_threads */
-    	int ready_threads = ready_queue_length();
-      if (!is_idle_thread (thread_current ()))
-        ready_threads++;
-    	real = multiply(divide(real59, real60), thread_get_real_load_avg ());
-      struct float32 load_avg =  add(real, multiply_int(divide(real1, real60), ready_threads));
-    	thread_set_load_avg(load_avg);
-
-      thread_foreach (calc_recent_cpu, NULL);
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      uint64_t now = timer_cycles ();
+      uint64_t wait = s->wakeup > now ? s->wakeup - now : 0;
+      uint64_t hr_count = (wait * PIT_HZ + tsc_hz - 1) / tsc_hz;
+
+      if (hr_count < count)
+        count = hr_count > 0 ? hr_count : 1;
     }
 
-    if(timer_ticks () % 4 == 0)
+  if (count == to_tick && (periodic || to_tick == PIT_TICK_COUNT))
     {
-    	thread_foreach (calc_priority, NULL);
-			intr_yield_on_return ();
+      /* The next interrupt is the next tick.  At a tick boundary,
+         restarting periodic mode keeps it in phase. */
+      if (!periodic)
+        pit_configure_channel (0, 2, TIMER_FREQ);
+      oneshot = false;
+      return;
     }
-  }
+
+  oneshot = true;
+  oneshot_first = to_tick;
+  oneshot_count = count;
+  pit_start_oneshot (0, oneshot_count);
 }
 
+/* Returns the number of ticks from now until the first tick, at
+   most MAX_TICKS away, at which the timing wheel has timers to
+   run or a level to cascade. */
+static int
+wheel_next_event (int max_ticks)
+{
+  int n;
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops (unsigned loops)
+  for (n = 1; n < max_ticks; n++)
+    {
+      int64_t t = ticks + n;
+      int slot = t & WHEEL_MASK;
+      if (slot == 0 || !list_empty (&wheel[0][slot]))
+        break;
+    }
+  return n;
+}
+
+/* Puts pending timer T into the timing wheel slot for its
+   expiration time, relative to wheel_ticks. */
+static void
+wheel_insert (struct timer_elem *t)
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  int64_t when = t->end_time;
+  int64_t delta = when - wheel_ticks;
+  int level;
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait (loops);
+  if (delta < 0)
+    {
+      /* Already expired: run it on the next tick processed. */
+      when = wheel_ticks;
+      delta = 0;
+    }
+  else if (delta >= (int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+    {
+      /* Too far away: park it in the last slot we can reach.  It
+         will be placed again when that slot cascades. */
+      delta = ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+      when = wheel_ticks + delta;
+    }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+  list_push_back (&wheel[level][(when >> (WHEEL_BITS * level)) & WHEEL_MASK],
+                  &t->elem);
+}
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+/* Moves all the elements of FROM to the end of TO. */
+static void
+wheel_take (struct list *to, struct list *from)
+{
+  list_init (to);
+  if (!list_empty (from))
+    list_splice (list_end (to), list_begin (from), list_end (from));
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Empties the slot of LEVEL that covers wheel_ticks and reinserts
+   its timers, which moves them down to lower levels.  Returns
+   true if that slot index is 0, meaning that LEVEL has also
+   wrapped around and the next level up must cascade too. */
+static bool
+wheel_cascade (int level)
+{
+  int slot = (wheel_ticks >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  struct list pending;
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops)
+  /* Move the slot's timers aside first, because reinserting them
+     may put some back into the same slot. */
+  wheel_take (&pending, &wheel[level][slot]);
+  while (!list_empty (&pending))
+    wheel_insert (list_entry (list_pop_front (&pending),
+                              struct timer_elem, elem));
+
+  return slot == 0;
+}
+
+/* Runs the timers that expire at wheel_ticks and advances
+   wheel_ticks by one. */
+static void
+wheel_advance (void)
 {
-  while (loops-- > 0)
-    barrier ();
+  int slot = wheel_ticks & WHEEL_MASK;
+  struct list expired;
+  int level;
+
+  if (slot == 0)
+    for (level = 1; level < WHEEL_LEVELS && wheel_cascade (level); level++)
+      continue;
+  wheel_ticks++;
+
+  /* Take the whole slot before running any timer function, since
+     one may rearm its timer into this same slot for a later
+     lap. */
+  wheel_take (&expired, &wheel[0][slot]);
+  while (!list_empty (&expired))
+    {
+      struct timer_elem *t = list_entry (list_pop_front (&expired),
+                                         struct timer_elem, elem);
+      t->pending = false;
+      trace_event (TRACE_TIMER, 0, t->end_time, 0);
+      t->func (t->aux);
+    }
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -307,7 +713,10 @@ real_time_sleep (int64_t num, int32_t denom)
   */
   int64_t ticks = num * TIMER_FREQ / denom;
 
+  int64_t ns = num * (NSEC_PER_SEC / denom);
+
   ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (NSEC_PER_SEC % denom == 0);
   if (ticks > 0)
     {
       /* We're waiting for at least one full timer tick.  Use
@@ -315,20 +724,82 @@ real_time_sleep (int64_t num, int32_t denom)
          processes. */
       timer_sleep (ticks);
     }
+  else if (ns >= HR_SLEEP_MIN_NS && tsc_hz != 0)
+    {
+      /* Block until a one-shot timer interrupt in the middle of
+         the tick, so that other threads can run meanwhile. */
+      hr_sleep (ns);
+    }
   else
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
+      /* Too short to be worth blocking.  Busy-wait. */
       real_time_delay (num, denom);
     }
 }
 
+/* Compares the wakeup times of hr_sleepers A and B. */
+static bool
+hr_sleeper_less (const struct list_elem *a, const struct list_elem *b,
+                 void *aux UNUSED)
+{
+  return (list_entry (a, struct hr_sleeper, elem)->wakeup
+          < list_entry (b, struct hr_sleeper, elem)->wakeup);
+}
+
+/* Blocks the current thread for NS nanoseconds, which should be
+   less than a tick. */
+static void
+hr_sleep (int64_t ns)
+{
+  struct hr_sleeper s;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  s.wakeup = timer_cycles () + ns_to_cycles (ns);
+  s.thread = thread_current ();
+  list_insert_ordered (&hr_sleepers, &s.elem, hr_sleeper_less, NULL);
+
+  /* If we are now the first sleeper, the timer interrupt may
+     have to come earlier than planned. */
+  if (list_front (&hr_sleepers) == &s.elem)
+    {
+      if (oneshot)
+        clock_program (oneshot_stop (), false);
+      else
+        clock_program (pit_read_counter (0, NULL), true);
+    }
+
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Wakes up the sub-tick sleepers whose time has come, allowing
+   one PIT cycle of slack for the rounding in clock_program(). */
+static void
+hr_wake (void)
+{
+  uint64_t now = timer_cycles () + tsc_hz / PIT_HZ;
+
+  while (!list_empty (&hr_sleepers))
+    {
+      struct hr_sleeper *s = list_entry (list_front (&hr_sleepers),
+                                         struct hr_sleeper, elem);
+      if (s->wakeup > now)
+        break;
+      list_pop_front (&hr_sleepers);
+      thread_unblock (s->thread);
+    }
+}
+
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void
 real_time_delay (int64_t num, int32_t denom)
 {
-  /* Scale the numerator and denominator down by 1000 to avoid
-     the possibility of overflow. */
-  ASSERT (denom % 1000 == 0);
-  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+  uint64_t start = timer_cycles ();
+  uint64_t cycles;
+
+  ASSERT (NSEC_PER_SEC % denom == 0);
+  cycles = ns_to_cycles (num * (NSEC_PER_SEC / denom));
+  while (timer_cycles () - start < cycles)
+    barrier ();
 }
@@ -4,13 +4,23 @@
 #include <round.h>
 #include <stdint.h>
 #include <list.h>
-
-/* Hold sleeping thread and their end times in ticks. */
-struct timer_elem {
-  struct list_elem elem;
-  struct thread *thread;
-  int64_t end_time;
-};
+#include <stdbool.h>
+
+/* Called when a kernel timer expires, passing along AUX.  Runs
+   in the timer interrupt handler with interrupts off, so it must
+   not sleep. */
+typedef void timer_func (void *aux);
+
+/* A kernel timer.  Owned by the caller, which must keep it alive
+   until it fires or is cancelled. */
+struct timer_elem
+  {
+    struct list_elem elem;      /* Element in a timing wheel slot. */
+    int64_t end_time;           /* Tick at which to fire. */
+    timer_func *func;           /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* True while in the timing wheel. */
+  };
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
@@ -27,11 +37,27 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* Kernel timers. */
+void timer_add (struct timer_elem *, int64_t when, timer_func *, void *aux);
+bool timer_cancel (struct timer_elem *);
+
+/* High-resolution clock, based on the time-stamp counter. */
+uint64_t timer_cycles (void);
+int64_t timer_cycles_to_ns (uint64_t cycles);
+int64_t timer_ns (void);
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
+int64_t timer_max_interrupt_ns (void);
+int64_t timer_mean_interrupt_ns (void);
+void timer_reset_max_interrupt (void);
+
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_exit (void);
 
 #endif /* devices/timer.h */
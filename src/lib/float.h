@@ -1,24 +1,107 @@
 #ifndef __LIB_FLOAT_H
 #define __LIB_FLOAT_H
 
-#define FLOAT_P 17
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Fixed-point real numbers, kept in 64 bits with FLOAT_Q bits
+   after the binary point.  Products fit in the representation
+   without a wider intermediate, and everything but division
+   compiles to a few inline instructions. */
+#define FLOAT_P 49
 #define FLOAT_Q 14
+#define FLOAT_F ((int64_t) 1 << FLOAT_Q)
 
-struct float32
+struct float64
 {
-  int n; /* First FLOAT_P bits represent the part before decimal point
-            and the remaining bits represent the part after the decimal point. */
+  int64_t n; /* First FLOAT_P bits represent the part before decimal point
+                and the remaining bits represent the part after the decimal point. */
 };
 
-struct float32 to_float (int x);
-struct float32 add (struct float32 x, struct float32 y);
-struct float32 add_int (struct float32 x, int y);
-struct float32 subtract (struct float32 x, struct float32 y);
-struct float32 subtract_int (struct float32 x, int y);
-struct float32 multiply (struct float32 x, struct float32 y);
-struct float32 multiply_int (struct float32 x, int y);
-struct float32 divide (struct float32 x, struct float32 y);
-struct float32 divide_int (struct float32 x, int y);
-int to_int (struct float32 x, bool round);
+/* Initializes a new float type from an int. */
+static inline struct float64
+to_float (int x)
+{
+  struct float64 ret = { x * FLOAT_F };
+  return ret;
+}
+
+/* Adds two floating point numbers. */
+static inline struct float64
+add (struct float64 x, struct float64 y)
+{
+  struct float64 ret = { x.n + y.n };
+  return ret;
+}
+
+/* Adds a floating point number and an int. */
+static inline struct float64
+add_int (struct float64 x, int y)
+{
+  struct float64 ret = { x.n + y * FLOAT_F };
+  return ret;
+}
+
+/* Subtracts two floating point numbers. */
+static inline struct float64
+subtract (struct float64 x, struct float64 y)
+{
+  struct float64 ret = { x.n - y.n };
+  return ret;
+}
+
+/* Subtracts a floating point number and an int. */
+static inline struct float64
+subtract_int (struct float64 x, int y)
+{
+  struct float64 ret = { x.n - y * FLOAT_F };
+  return ret;
+}
+
+/* Multiplies two floating point numbers. */
+static inline struct float64
+multiply (struct float64 x, struct float64 y)
+{
+  struct float64 ret = { x.n * y.n / FLOAT_F };
+  return ret;
+}
+
+/* Multiplies a floating point number and an int. */
+static inline struct float64
+multiply_int (struct float64 x, int y)
+{
+  struct float64 ret = { x.n * y };
+  return ret;
+}
+
+/* Divides two floating point numbers. */
+static inline struct float64
+divide (struct float64 x, struct float64 y)
+{
+  struct float64 ret = { x.n * FLOAT_F / y.n };
+  return ret;
+}
+
+/* Divides a floating point number and an int. */
+static inline struct float64
+divide_int (struct float64 x, int y)
+{
+  struct float64 ret = { x.n / y };
+  return ret;
+}
+
+/* Converts a float to an int. If round set to true,
+   then the value is rounded to the nearest integer,
+   else the part after the decimal point is truncated. */
+static inline int
+to_int (struct float64 x, bool round)
+{
+  if (!round)
+    return x.n / FLOAT_F;
+  else if (x.n >= 0)
+    return (x.n + FLOAT_F / 2) / FLOAT_F;
+  else
+    return (x.n - FLOAT_F / 2) / FLOAT_F;
+}
 
 #endif /* lib/float.h */
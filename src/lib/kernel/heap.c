@@ -0,0 +1,252 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Our heap is a leftist tree: every node's left child has a rank
+   at least as large as its right child's, where a node's rank is
+   one more than the rank of its right child and a null child has
+   rank 0.  The rightmost path is therefore at most O(log n) long,
+   and two heaps are merged by walking down their rightmost paths.
+   Every other operation is a merge.
+
+   Each element also keeps a pointer to its parent, so that it
+   can be unlinked from the middle of the heap. */
+
+static struct heap_elem *merge (struct heap *,
+                                struct heap_elem *, struct heap_elem *);
+static void insert (struct heap *, struct heap_elem *, uint64_t seq);
+static struct heap_elem *first_leaf (struct heap_elem *);
+
+/* Returns the rank of E, which may be null. */
+static inline int
+rank (const struct heap_elem *e)
+{
+  return e != NULL ? e->rank : 0;
+}
+
+/* Returns true if A should come out of heap H before B. */
+static inline bool
+before (struct heap *h, const struct heap_elem *a, const struct heap_elem *b)
+{
+  if (h->less (a, b, h->aux))
+    return true;
+  else if (h->less (b, a, h->aux))
+    return false;
+  else
+    return a->seq < b->seq;
+}
+
+/* Initializes H as an empty heap ordered by LESS given auxiliary
+   data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->top = NULL;
+  h->elem_cnt = 0;
+  h->next_seq = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_insert (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  insert (h, e, h->next_seq++);
+}
+
+/* Returns the smallest element in H.  Undefined behavior if H is
+   empty. */
+struct heap_elem *
+heap_min (struct heap *h)
+{
+  ASSERT (!heap_empty (h));
+
+  return h->top;
+}
+
+/* Removes and returns the smallest element in H.  Undefined
+   behavior if H is empty. */
+struct heap_elem *
+heap_pop_min (struct heap *h)
+{
+  struct heap_elem *e = heap_min (h);
+
+  heap_remove (h, e);
+  return e;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e)
+{
+  struct heap_elem *parent = e->parent;
+  struct heap_elem *sub = merge (h, e->left, e->right);
+
+  ASSERT (heap_contains (e));
+
+  if (sub != NULL)
+    sub->parent = parent;
+  if (parent == NULL)
+    h->top = sub;
+  else
+    {
+      if (parent->left == e)
+        parent->left = sub;
+      else
+        parent->right = sub;
+
+      /* Restore the leftist property on the path to the top,
+         stopping once a rank comes out unchanged. */
+      for (; parent != NULL; parent = parent->parent)
+        {
+          int new_rank;
+
+          if (rank (parent->left) < rank (parent->right))
+            {
+              struct heap_elem *tmp = parent->left;
+              parent->left = parent->right;
+              parent->right = tmp;
+            }
+          new_rank = rank (parent->right) + 1;
+          if (new_rank == parent->rank)
+            break;
+          parent->rank = new_rank;
+        }
+    }
+  e->parent = e->left = e->right = NULL;
+  e->rank = 0;
+  h->elem_cnt--;
+}
+
+/* Restores H's order after the key of E, which is in H, has
+   changed.  E keeps its place among the elements that compare
+   equal to it. */
+void
+heap_rekey (struct heap *h, struct heap_elem *e)
+{
+  uint64_t seq = e->seq;
+
+  heap_remove (h, e);
+  insert (h, e, seq);
+}
+
+/* Removes all the elements from H, calling ACTION on each one in
+   no particular order, in O(n) time, and passing it AUX.  ACTION
+   may free or reuse the memory of the element that it is passed,
+   and H is empty by the time it is first called. */
+void
+heap_clear (struct heap *h, heap_action_func *action, void *aux)
+{
+  struct heap_elem *e;
+
+  ASSERT (h != NULL);
+  ASSERT (action != NULL);
+
+  /* Visit the elements in postorder, finding each one's
+     successor before handing it to ACTION. */
+  e = h->top != NULL ? first_leaf (h->top) : NULL;
+  h->top = NULL;
+  h->elem_cnt = 0;
+  while (e != NULL)
+    {
+      struct heap_elem *parent = e->parent;
+      struct heap_elem *next;
+
+      if (parent == NULL)
+        next = NULL;
+      else if (parent->left == e && parent->right != NULL)
+        next = first_leaf (parent->right);
+      else
+        next = parent;
+
+      e->parent = e->left = e->right = NULL;
+      e->rank = 0;
+      action (e, aux);
+      e = next;
+    }
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (struct heap *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (struct heap *h)
+{
+  return h->top == NULL;
+}
+
+/* Returns true if E is in a heap, false otherwise.  E must have
+   been zeroed or removed from a heap before, rather than left
+   uninitialized. */
+bool
+heap_contains (const struct heap_elem *e)
+{
+  return e->rank > 0;
+}
+
+/* Inserts E into H with sequence number SEQ. */
+static void
+insert (struct heap *h, struct heap_elem *e, uint64_t seq)
+{
+  e->parent = e->left = e->right = NULL;
+  e->rank = 1;
+  e->seq = seq;
+  h->top = merge (h, h->top, e);
+  h->top->parent = NULL;
+  h->elem_cnt++;
+}
+
+/* Returns the first element of the subheap rooted at E in
+   postorder. */
+static struct heap_elem *
+first_leaf (struct heap_elem *e)
+{
+  for (;;)
+    if (e->left != NULL)
+      e = e->left;
+    else if (e->right != NULL)
+      e = e->right;
+    else
+      return e;
+}
+
+/* Merges the subheaps rooted at A and B and returns the new
+   root.  Does not set the root's parent. */
+static struct heap_elem *
+merge (struct heap *h, struct heap_elem *a, struct heap_elem *b)
+{
+  struct heap_elem *tmp;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (before (h, b, a))
+    {
+      tmp = a;
+      a = b;
+      b = tmp;
+    }
+
+  a->right = merge (h, a->right, b);
+  a->right->parent = a;
+  if (rank (a->left) < rank (a->right))
+    {
+      tmp = a->left;
+      a->left = a->right;
+      a->right = tmp;
+    }
+  a->rank = rank (a->right) + 1;
+  return a;
+}
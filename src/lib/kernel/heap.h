@@ -0,0 +1,79 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+
+   This is a leftist min-heap.  Like the linked list, it does not
+   use dynamic allocation: each structure that can potentially be
+   in a heap must embed a struct heap_elem member, and the
+   heap_entry macro converts from a struct heap_elem back to the
+   structure that contains it.  Refer to lib/kernel/list.h for a
+   detailed explanation of the technique.
+
+   The smallest element according to the heap's comparison
+   function is always at the top.  Elements that compare equal
+   come out in the order they were inserted.  Inserting,
+   removing the minimum, and removing an arbitrary element all
+   take O(log n) time.
+
+   An element's key must not change while it is in a heap unless
+   heap_rekey() is called right after, which keeps the element's
+   place among those that compare equal to it. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *parent;   /* Parent, or null at the top. */
+    struct heap_elem *left;     /* Left child, the higher-ranked one. */
+    struct heap_elem *right;    /* Right child. */
+    int rank;                   /* Length of rightmost path, 0 if not in a heap. */
+    uint64_t seq;               /* Insertion order, to break ties. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->parent   \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Performs some operation on heap element E, given auxiliary
+   data AUX. */
+typedef void heap_action_func (struct heap_elem *e, void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *top;      /* Smallest element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements. */
+    uint64_t next_seq;          /* Sequence number for next insertion. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_insert (struct heap *, struct heap_elem *);
+struct heap_elem *heap_min (struct heap *);
+struct heap_elem *heap_pop_min (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_rekey (struct heap *, struct heap_elem *);
+void heap_clear (struct heap *, heap_action_func *, void *aux);
+
+size_t heap_size (struct heap *);
+bool heap_empty (struct heap *);
+bool heap_contains (const struct heap_elem *);
+
+#endif /* lib/kernel/heap.h */
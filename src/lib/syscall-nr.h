@@ -28,7 +28,17 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_THREAD_STATS,           /* Obtain CPU accounting for this thread. */
+    SYS_FUTEX_WAIT,             /* Sleep until a futex changes. */
+    SYS_FUTEX_WAKE              /* Wake threads sleeping on a futex. */
   };
 
+/* Error returns from SYS_FUTEX_WAIT and SYS_FUTEX_WAKE. */
+#define FUTEX_AGAIN (-1)        /* Futex did not hold the expected value. */
+#define FUTEX_TIMEDOUT (-2)     /* Timeout passed first. */
+#define FUTEX_FAULT (-3)        /* Not a valid futex address. */
+
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,20 @@
+#ifndef __LIB_THREAD_STATS_H
+#define __LIB_THREAD_STATS_H
+
+#include <stdint.h>
+
+/* CPU accounting for one thread, as returned by the kernel's
+   thread_get_stats() and by the thread_stats system call.  Times
+   are in nanoseconds, measured with the time-stamp counter at
+   every change of the thread's state. */
+struct thread_stats
+  {
+    int64_t run_ns;             /* Time spent running. */
+    int64_t ready_ns;           /* Time spent waiting in a run queue. */
+    int64_t blocked_ns;         /* Time spent blocked. */
+    int64_t donated_ns;         /* Time with a donated priority. */
+    unsigned voluntary_switches;   /* # of times blocked or yielded. */
+    unsigned involuntary_switches; /* # of times preempted. */
+  };
+
+#endif /* lib/thread-stats.h */
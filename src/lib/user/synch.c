@@ -0,0 +1,134 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+#include "../syscall-nr.h"
+
+/* The mutex is the one described by Ulrich Drepper in "Futexes
+   Are Tricky": a locker that finds the mutex held marks it
+   contended before sleeping, so that the unlocker knows to make
+   the system call that wakes it, and an unlocker that finds it
+   uncontended makes none. */
+
+/* Atomically sets *P to NEW if it is OLD.  Returns the value *P
+   had before. */
+static inline int
+compare_and_swap (int *p, int old, int new)
+{
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "+a" (old), "+m" (*p)
+                : "r" (new)
+                : "memory");
+  return old;
+}
+
+/* Atomically sets *P to NEW and returns the value it had
+   before. */
+static inline int
+exchange (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Atomically adds 1 to *P. */
+static inline void
+increment (int *p)
+{
+  asm volatile ("lock incl %0" : "+m" (*p) : : "memory");
+}
+
+/* Initializes mutex M as unlocked. */
+void
+mutex_init (struct mutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires mutex M, sleeping until it is available if
+   necessary. */
+void
+mutex_lock (struct mutex *m)
+{
+  int c = compare_and_swap (&m->state, 0, 1);
+
+  if (c == 0)
+    return;
+  if (c != 2)
+    c = exchange (&m->state, 2);
+  while (c != 0)
+    {
+      futex_wait (&m->state, 2, -1);
+      c = exchange (&m->state, 2);
+    }
+}
+
+/* Acquires mutex M if it is available, without sleeping.
+   Returns true if successful, false if M is held. */
+bool
+mutex_trylock (struct mutex *m)
+{
+  return compare_and_swap (&m->state, 0, 1) == 0;
+}
+
+/* Releases mutex M, which the caller must hold, waking one
+   waiter if there may be any. */
+void
+mutex_unlock (struct mutex *m)
+{
+  if (exchange (&m->state, 0) == 2)
+    futex_wake (&m->state, 1);
+}
+
+/* Initializes condition variable CV. */
+void
+cond_init (struct condvar *cv)
+{
+  cv->seq = 0;
+}
+
+/* Atomically releases mutex M, which the caller must hold, and
+   waits for CV to be signaled, then reacquires M.  As with any
+   condition variable, the caller must recheck its condition
+   after waking. */
+void
+cond_wait (struct condvar *cv, struct mutex *m)
+{
+  cond_timedwait (cv, m, -1);
+}
+
+/* Like cond_wait(), but gives up waiting after TIMEOUT_MS
+   milliseconds, or never if TIMEOUT_MS is negative.  Returns
+   false if it timed out, true otherwise.  M is reacquired in
+   either case. */
+bool
+cond_timedwait (struct condvar *cv, struct mutex *m, int timeout_ms)
+{
+  int seq = cv->seq;
+  int result;
+
+  mutex_unlock (m);
+  result = futex_wait (&cv->seq, seq, timeout_ms);
+
+  /* Others may be waiting behind us once we were woken, so
+     reacquire M as contended to be sure they get woken too. */
+  while (exchange (&m->state, 2) != 0)
+    futex_wait (&m->state, 2, -1);
+
+  return result != FUTEX_TIMEDOUT;
+}
+
+/* Wakes one thread waiting on CV, if there is one. */
+void
+cond_signal (struct condvar *cv)
+{
+  increment (&cv->seq);
+  futex_wake (&cv->seq, 1);
+}
+
+/* Wakes all threads waiting on CV. */
+void
+cond_broadcast (struct condvar *cv)
+{
+  increment (&cv->seq);
+  futex_wake (&cv->seq, INT_MAX);
+}
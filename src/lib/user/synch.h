@@ -0,0 +1,43 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* User-space mutexes and condition variables.
+
+   Both are built on futexes.  Locking and unlocking an
+   uncontended mutex take one atomic instruction each and never
+   enter the kernel.  Only a thread that must wait, or that must
+   wake a waiter, makes a system call. */
+
+/* Mutex.  STATE is 0 if unlocked, 1 if locked with no waiters,
+   or 2 if locked with threads possibly waiting. */
+struct mutex
+  {
+    int state;
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable.  SEQ changes on every signal, so that a
+   waiter can tell whether a signal came between releasing the
+   mutex and going to sleep. */
+struct condvar
+  {
+    int seq;
+  };
+
+#define CONDVAR_INITIALIZER { 0 }
+
+void cond_init (struct condvar *);
+void cond_wait (struct condvar *, struct mutex *);
+bool cond_timedwait (struct condvar *, struct mutex *, int timeout_ms);
+void cond_signal (struct condvar *);
+void cond_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
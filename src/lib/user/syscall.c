@@ -182,3 +182,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+thread_stats (struct thread_stats *stats)
+{
+  return syscall1 (SYS_THREAD_STATS, stats);
+}
+
+int
+futex_wait (int *futex, int expected, int timeout_ms)
+{
+  return syscall3 (SYS_FUTEX_WAIT, futex, expected, timeout_ms);
+}
+
+int
+futex_wake (int *futex, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, futex, cnt);
+}
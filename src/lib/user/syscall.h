@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <thread-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +46,9 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool thread_stats (struct thread_stats *);
+int futex_wait (int *futex, int expected, int timeout_ms);
+int futex_wake (int *futex, int cnt);
+
 #endif /* lib/user/syscall.h */
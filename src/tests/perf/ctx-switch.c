@@ -0,0 +1,52 @@
+/* Measures context switch latency with a semaphore ping-pong, as
+   in sema_self_test().
+
+   The main thread and a helper at the same priority take turns
+   raising a semaphore the other is waiting on and then waiting on
+   their own, so that each round trip is exactly two switches. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUNDS 1000
+#define WARMUP 10
+
+static struct semaphore ping, pong;
+
+static void helper (void *);
+
+void
+test_ctx_switch (void)
+{
+  uint64_t start = 0;
+  int i;
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  thread_create ("pong", PRI_DEFAULT, helper, NULL);
+
+  for (i = 0; i < WARMUP + ROUNDS; i++)
+    {
+      if (i == WARMUP)
+        start = timer_cycles ();
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  perf_report ("switch",
+               timer_cycles_to_ns (timer_cycles () - start) / (2 * ROUNDS),
+               "ns");
+}
+
+static void
+helper (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < WARMUP + ROUNDS; i++)
+    {
+      sema_down (&ping);
+      sema_up (&pong);
+    }
+}
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+check_perf ({switch => 4_000_000});
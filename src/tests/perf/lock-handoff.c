@@ -0,0 +1,57 @@
+/* Measures the cost of handing a contended lock from thread to
+   thread.
+
+   THREAD_CNT threads each acquire a lock ITERATIONS times, and
+   yield while holding it so that the others queue up behind them.
+   Nearly every release therefore hands the lock to a waiter. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define ITERATIONS 200
+
+static struct lock lock;
+static struct semaphore start, done;
+
+static void contender (void *);
+
+void
+test_lock_handoff (void)
+{
+  uint64_t begin;
+  int i;
+
+  lock_init (&lock);
+  sema_init (&start, 0);
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_create ("contender", PRI_DEFAULT + 1, contender, NULL);
+
+  begin = timer_cycles ();
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_up (&start);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  perf_report ("handoff",
+               timer_cycles_to_ns (timer_cycles () - begin)
+               / (THREAD_CNT * ITERATIONS),
+               "ns");
+}
+
+static void
+contender (void *aux UNUSED)
+{
+  int i;
+
+  sema_down (&start);
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      lock_acquire (&lock);
+      thread_yield ();
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
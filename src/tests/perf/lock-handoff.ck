@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+check_perf ({handoff => 20_000_000});
@@ -0,0 +1,112 @@
+/* Measures malloc() and free() with many threads allocating at
+   once.
+
+   Each thread makes OP_CNT calls, freeing the block in a slot if
+   there is one or allocating a block of random size from 16 to
+   512 bytes into it if not, and yields every YIELD_OPS calls so
+   that the threads interleave even between timer interrupts.
+   Each run reports the mean time per call and the number of
+   descriptor locks taken per 1000 calls.
+
+   The runs are made with a single thread and with THREAD_CNT
+   threads, first with the magazines bypassed, so that every call
+   takes a descriptor lock, and then with them in use.  With only
+   one CPU, threads contend for a descriptor lock only when one is
+   preempted while holding it, so the timings mostly show the cost
+   of taking the lock at all.  The lock counts show how often
+   calls would meet on a lock with more CPUs: with the magazines,
+   almost every call is served without taking one. */
+
+#include "tests/perf/perf.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+#define SLOT_CNT 16
+#define OP_CNT 2000
+#define YIELD_OPS 50
+
+static struct semaphore start, done;
+
+static void run_threads (int thread_cnt, bool magazines, const char *metric);
+static void allocator (void *);
+
+void
+test_malloc_threads (void)
+{
+  run_threads (1, false, "nomag-1-thread");
+  run_threads (THREAD_CNT, false, "nomag-8-threads");
+  run_threads (1, true, "malloc-1-thread");
+  run_threads (THREAD_CNT, true, "malloc-8-threads");
+  malloc_magazines = true;
+}
+
+/* Runs THREAD_CNT allocator threads, with the magazines in use
+   if MAGAZINES is true, and reports the mean time per call as
+   METRIC and the descriptor locks taken per 1000 calls as
+   METRIC-locks. */
+static void
+run_threads (int thread_cnt, bool magazines, const char *metric)
+{
+  char locks_metric[32];
+  size_t call_cnt = thread_cnt * OP_CNT;
+  size_t lock_cnt;
+  uint64_t begin;
+  int i;
+
+  malloc_magazines = magazines;
+  lock_cnt = malloc_lock_cnt ();
+  sema_init (&start, 0);
+  sema_init (&done, 0);
+  for (i = 0; i < thread_cnt; i++)
+    thread_create ("allocator", PRI_DEFAULT + 1, allocator, (void *) i);
+
+  begin = timer_cycles ();
+  for (i = 0; i < thread_cnt; i++)
+    sema_up (&start);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&done);
+  perf_report (metric,
+               timer_cycles_to_ns (timer_cycles () - begin) / call_cnt, "ns");
+
+  snprintf (locks_metric, sizeof locks_metric, "%s-locks", metric);
+  perf_report (locks_metric,
+               (malloc_lock_cnt () - lock_cnt) * 1000 / call_cnt, "locks");
+}
+
+static void
+allocator (void *seed_)
+{
+  void *slots[SLOT_CNT] = { NULL };
+  unsigned seed = (unsigned) seed_ + 1;
+  int i;
+
+  sema_down (&start);
+  for (i = 0; i < OP_CNT; i++)
+    {
+      void **slot;
+
+      seed = seed * 1103515245 + 12345;
+      slot = &slots[(seed >> 16) % SLOT_CNT];
+      if (*slot != NULL)
+        {
+          free (*slot);
+          *slot = NULL;
+        }
+      else
+        {
+          *slot = malloc (16 << ((seed >> 8) % 6));
+          if (*slot == NULL)
+            fail ("malloc failed");
+        }
+      if (i % YIELD_OPS == YIELD_OPS - 1)
+        thread_yield ();
+    }
+  for (i = 0; i < SLOT_CNT; i++)
+    free (slots[i]);
+  sema_up (&done);
+}
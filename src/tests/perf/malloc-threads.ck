@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+# Without the magazines, every call takes a descriptor lock, so
+# only the runs that use them are held to a low lock count.
+check_perf ({'nomag-1-thread' => 1_000_000,
+	     'nomag-1-thread-locks' => 2_000,
+	     'nomag-8-threads' => 2_000_000,
+	     'nomag-8-threads-locks' => 2_000,
+	     'malloc-1-thread' => 1_000_000,
+	     'malloc-1-thread-locks' => 250,
+	     'malloc-8-threads' => 2_000_000,
+	     'malloc-8-threads-locks' => 250});
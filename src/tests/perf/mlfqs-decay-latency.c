@@ -0,0 +1,94 @@
+/* Measures how long interrupts stay off while many threads are
+   ready to run under the MLFQS, before and after batching the
+   once-a-second decay.
+
+   The main thread starts THREAD_CNT threads that spin, then
+   sleeps for MEASURE_SECS seconds while they compete for the CPU,
+   twice.  Every ready thread's recent_cpu is decayed once a
+   second, which takes the run queue lock and so turns interrupts
+   off.  The first time, the decay updates the whole run queue
+   under one lock hold, as the kernel did before batching.  The
+   second time, it takes the lock for at most thread_decay_batch
+   threads at a time, so the longest time with interrupts off
+   should no longer grow with the number of ready threads.
+
+   Reports the longest time with interrupts off and the longest
+   external interrupt both times, and the batched time with
+   interrupts off as a percentage of the unbatched one.  Needs the
+   "-intr-timing" kernel option. */
+
+#include "tests/perf/perf.h"
+#include <limits.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 200
+#define MEASURE_SECS 3
+
+static volatile bool stop;
+static struct semaphore done;
+
+static thread_func spinner;
+static int64_t measure (const char *name, int batch);
+
+void
+test_mlfqs_decay_latency (void)
+{
+  int batch = thread_decay_batch;
+  int64_t unbatched_ns, batched_ns;
+  int i;
+
+  ASSERT (thread_mlfqs);
+  ASSERT (intr_timing);
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_create ("spinner", PRI_DEFAULT, spinner, NULL);
+
+  unbatched_ns = measure ("unbatched", INT_MAX);
+  batched_ns = measure ("batched", batch);
+  thread_decay_batch = batch;
+  perf_report ("batched-off-pct",
+               unbatched_ns > 0 ? batched_ns * 100 / unbatched_ns : 0,
+               "%");
+
+  stop = true;
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+}
+
+/* Runs the decay BATCH threads at a time for MEASURE_SECS
+   seconds, reports the longest times with interrupts off and in
+   an external interrupt as NAME-off and NAME-external, and
+   returns the former. */
+static int64_t
+measure (const char *name, int batch)
+{
+  char metric[32];
+  int64_t off_ns, external_ns;
+
+  thread_decay_batch = batch;
+  intr_reset_max_external ();
+  intr_reset_max_off ();
+  timer_sleep (MEASURE_SECS * TIMER_FREQ);
+  off_ns = intr_max_off_ns ();
+  external_ns = intr_max_external_ns ();
+
+  snprintf (metric, sizeof metric, "%s-off", name);
+  perf_report (metric, off_ns, "ns");
+  snprintf (metric, sizeof metric, "%s-external", name);
+  perf_report (metric, external_ns, "ns");
+  return off_ns;
+}
+
+static void
+spinner (void *aux UNUSED)
+{
+  while (!stop)
+    continue;
+  sema_up (&done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+# The unbatched run is the baseline, so it is only reported.  The
+# batched run must keep interrupts off for at most half as long.
+check_perf ({'unbatched-off' => 1_000_000_000,
+	     'unbatched-external' => 30_000_000,
+	     'batched-off' => 30_000_000,
+	     'batched-external' => 30_000_000,
+	     'batched-off-pct' => 50});
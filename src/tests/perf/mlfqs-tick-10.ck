@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+check_perf ({'tick-mean' => 5_000_000, 'tick-max' => 30_000_000});
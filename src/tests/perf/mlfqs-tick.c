@@ -0,0 +1,71 @@
+/* Measures the cost of the timer interrupt under the MLFQS with
+   10, 100, and 1000 threads in the system.
+
+   The main thread starts the threads, which block on a
+   semaphore, then spins for MEASURE_SECS seconds so that the
+   once-per-second load average and recent_cpu updates run
+   several times, and reports the mean and longest timer
+   interrupt.  Blocked threads should add little to either. */
+
+#include "tests/perf/perf.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MEASURE_SECS 2
+
+static struct semaphore wakeup, done;
+
+static void blocker (void *);
+
+static void
+measure_tick (int thread_cnt)
+{
+  int64_t start;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&wakeup, 0);
+  sema_init (&done, 0);
+  for (i = 0; i < thread_cnt; i++)
+    thread_create ("blocker", PRI_DEFAULT, blocker, NULL);
+
+  timer_reset_max_interrupt ();
+  start = timer_ticks ();
+  while (timer_elapsed (start) < MEASURE_SECS * TIMER_FREQ)
+    continue;
+  perf_report ("tick-mean", timer_mean_interrupt_ns (), "ns");
+  perf_report ("tick-max", timer_max_interrupt_ns (), "ns");
+
+  for (i = 0; i < thread_cnt; i++)
+    sema_up (&wakeup);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&done);
+}
+
+void
+test_mlfqs_tick_10 (void)
+{
+  measure_tick (10);
+}
+
+void
+test_mlfqs_tick_100 (void)
+{
+  measure_tick (100);
+}
+
+void
+test_mlfqs_tick_1000 (void)
+{
+  measure_tick (1000);
+}
+
+static void
+blocker (void *aux UNUSED)
+{
+  sema_down (&wakeup);
+  sema_up (&done);
+}
@@ -0,0 +1,66 @@
+/* Measures the page allocator under a random mix of allocations
+   and frees.
+
+   Keeps up to SLOT_CNT blocks of 1 to MAX_PAGES pages allocated.
+   Each step picks a slot at random and frees its block if it has
+   one, or allocates a block of random size into it if not, so
+   that the free memory is split up in many different ways.
+   Reports the mean time per operation, then checks that every
+   page came back by comparing the free memory before and after,
+   as perf_free_pages() counts it. */
+
+#include "tests/perf/perf.h"
+#include <debug.h>
+#include <random.h>
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+#define SLOT_CNT 64
+#define MAX_PAGES 8
+#define OP_CNT 20000
+
+struct slot
+  {
+    void *pages;
+    size_t page_cnt;
+  };
+
+static struct slot slots[SLOT_CNT];
+
+void
+test_palloc_random (void)
+{
+  size_t free_before = perf_free_pages ();
+  uint64_t start;
+  int op_cnt = 0;
+  int i;
+
+  random_init (0);
+  start = timer_cycles ();
+  for (i = 0; i < OP_CNT; i++)
+    {
+      struct slot *s = &slots[random_ulong () % SLOT_CNT];
+      if (s->pages != NULL)
+        {
+          palloc_free_multiple (s->pages, s->page_cnt);
+          s->pages = NULL;
+        }
+      else
+        {
+          s->page_cnt = random_ulong () % MAX_PAGES + 1;
+          s->pages = palloc_get_multiple (0, s->page_cnt);
+          if (s->pages == NULL)
+            fail ("out of memory allocating %zu pages", s->page_cnt);
+        }
+      op_cnt++;
+    }
+  perf_report ("alloc-free",
+               timer_cycles_to_ns (timer_cycles () - start) / op_cnt, "ns");
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slots[i].pages != NULL)
+      palloc_free_multiple (slots[i].pages, slots[i].page_cnt);
+  if (perf_free_pages () != free_before)
+    fail ("%zu pages free before, %zu after",
+          free_before, perf_free_pages ());
+}
@@ -0,0 +1,59 @@
+/* Measures PAL_ZERO page allocations once the idle thread has
+   had time to zero pages ahead of them.
+
+   Sleeps for a second so that the idle thread can refill the
+   kernel pool's stock, then allocates PAGE_CNT pages with
+   PAL_ZERO, no more
+   than the stock holds, and reports the mean time per page.
+   Each page must come back all zeros, even though the pages are
+   dirtied and freed in between rounds. */
+
+#include "tests/perf/perf.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 16
+#define ROUND_CNT 4
+
+static void *pages[PAGE_CNT];
+
+void
+test_palloc_zero (void)
+{
+  uint64_t cycles = 0;
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      uint64_t start;
+
+      timer_sleep (TIMER_FREQ);
+
+      start = timer_cycles ();
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          pages[i] = palloc_get_page (PAL_ZERO);
+          if (pages[i] == NULL)
+            fail ("palloc_get_page failed");
+        }
+      cycles += timer_cycles () - start;
+
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          const uint8_t *p = pages[i];
+          size_t ofs;
+
+          for (ofs = 0; ofs < PGSIZE; ofs++)
+            if (p[ofs] != 0)
+              fail ("round %d: page %d not zeroed at offset %zu",
+                    round, i, ofs);
+          memset (pages[i], 0x5a, PGSIZE);
+          palloc_free_page (pages[i]);
+        }
+    }
+  perf_report ("zero-page",
+               timer_cycles_to_ns (cycles) / (ROUND_CNT * PAGE_CNT), "ns");
+}
@@ -0,0 +1,38 @@
+#include "tests/perf/perf.h"
+#include <inttypes.h>
+#include "threads/palloc.h"
+
+/* Reports VALUE, in UNIT, as the result for METRIC, in the form
+   that tests/perf/perf.pm parses:
+
+        (TEST) PERF METRIC VALUE UNIT */
+void
+perf_report (const char *metric, int64_t value, const char *unit)
+{
+  msg ("PERF %s %"PRId64" %s", metric, value, unit);
+}
+
+/* Returns the number of pages that can be allocated from the
+   kernel pool, by allocating them all one at a time and then
+   freeing them again. */
+size_t
+perf_free_pages (void)
+{
+  void *head = NULL;
+  void *page;
+  size_t cnt = 0;
+
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = head;
+      head = page;
+      cnt++;
+    }
+  while (head != NULL)
+    {
+      page = head;
+      head = *(void **) page;
+      palloc_free_page (page);
+    }
+  return cnt;
+}
@@ -0,0 +1,33 @@
+#ifndef TESTS_PERF_PERF_H
+#define TESTS_PERF_PERF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+
+/* Scheduler and synchronization benchmarks.
+
+   These run in the threads kernel like the tests in
+   tests/threads, but report timings instead of checking
+   behavior.  Each timing is printed by perf_report() on a line
+   of its own, and the test's .ck file fails the test if any
+   timing exceeds its limit.  See tests/perf/perf.pm. */
+
+extern test_func test_ctx_switch;
+extern test_func test_lock_handoff;
+extern test_func test_sleep_jitter;
+extern test_func test_thread_churn;
+extern test_func test_palloc_random;
+extern test_func test_palloc_zero;
+extern test_func test_slab_alloc;
+extern test_func test_malloc_threads;
+extern test_func test_mlfqs_tick_10;
+extern test_func test_mlfqs_tick_100;
+extern test_func test_mlfqs_tick_1000;
+extern test_func test_mlfqs_decay_latency;
+extern test_func test_smp_throughput;
+
+void perf_report (const char *metric, int64_t value, const char *unit);
+size_t perf_free_pages (void);
+
+#endif /* tests/perf/perf.h */
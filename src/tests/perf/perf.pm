@@ -0,0 +1,45 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Checks the output of a benchmark in tests/perf.  %$LIMITS maps
+# each metric that the benchmark reports to the largest value it
+# may take.  Fails if a metric is missing, unexpected, or over its
+# limit; otherwise the rest of the output must be just the usual
+# "begin" and "end" lines.
+#
+# The limits are loose enough for Bochs, which runs about one
+# instruction per simulated microsecond.  To hold a faster
+# simulator to tighter limits, set PINTOS_PERF_SLACK to the factor
+# to scale them by, e.g. 0.01.  Only timings, in ns, are scaled.
+sub check_perf {
+    my ($limits) = @_;
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    my ($slack) = $ENV{PINTOS_PERF_SLACK} || 1;
+    my (%seen, @failures);
+    foreach (@output) {
+	my ($metric, $value, $unit) = /^\(\S+\) PERF (\S+) (-?\d+) (\S+)$/
+	  or next;
+	my ($limit) = $limits->{$metric};
+	fail "Unexpected metric $metric in output.\n" if !defined $limit;
+	$seen{$metric} = 1;
+	$limit *= $slack if $unit eq 'ns';
+	push (@failures, "$metric = $value $unit, over limit of $limit $unit")
+	  if $value > $limit;
+    }
+    foreach my $metric (sort keys %$limits) {
+	fail "Missing metric $metric in output.\n" if !$seen{$metric};
+    }
+    fail join ("\n", @failures) . "\n" if @failures;
+
+    my ($name) = $test =~ m%([^/]+)$%;
+    compare_output ("run", [grep (!/ PERF /, @output)],
+		    ["($name) begin\n($name) end\n"]);
+    pass;
+}
+
+1;
@@ -0,0 +1,127 @@
+/* Compares an object cache against malloc() for objects the size
+   of a `struct inode', which malloc() rounds up to 1 kB.
+
+   Allocates OBJ_CNT objects each way and reports how many pages
+   they took, then times ROUND_CNT rounds of allocating and
+   freeing all of them.  The cache has a constructor, and the
+   test checks that every object it hands out, including reused
+   ones, is still in its constructed state. */
+
+#include "tests/perf/perf.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "devices/timer.h"
+
+#define OBJ_CNT 256
+#define ROUND_CNT 20
+
+/* Test object. */
+struct obj
+  {
+    unsigned magic;
+    char data[532];
+  };
+
+/* Marks a constructed object. */
+#define OBJ_MAGIC 0xc0ffee
+
+static void *objs[OBJ_CNT];
+
+static void obj_ctor (void *);
+static void run_slab (struct kmem_cache *, bool timed);
+static void run_malloc (bool timed);
+
+void
+test_slab_alloc (void)
+{
+  struct kmem_cache *cache;
+  size_t free_pages, slab_pages, malloc_pages;
+  uint64_t start;
+  int i;
+
+  cache = kmem_cache_create ("slab-alloc", sizeof (struct obj), 0, obj_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create failed");
+
+  /* Memory. */
+  free_pages = perf_free_pages ();
+  run_slab (cache, false);
+  slab_pages = free_pages - perf_free_pages ();
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+
+  free_pages = perf_free_pages ();
+  run_malloc (false);
+  malloc_pages = free_pages - perf_free_pages ();
+  for (i = 0; i < OBJ_CNT; i++)
+    free (objs[i]);
+
+  perf_report ("slab-pages", slab_pages, "pages");
+  perf_report ("malloc-pages", malloc_pages, "pages");
+  if (slab_pages >= malloc_pages)
+    fail ("object cache took %zu pages, malloc only %zu",
+          slab_pages, malloc_pages);
+
+  /* Throughput. */
+  start = timer_cycles ();
+  for (i = 0; i < ROUND_CNT; i++)
+    run_slab (cache, true);
+  perf_report ("slab-alloc-free",
+               timer_cycles_to_ns (timer_cycles () - start)
+               / (ROUND_CNT * OBJ_CNT), "ns");
+
+  start = timer_cycles ();
+  for (i = 0; i < ROUND_CNT; i++)
+    run_malloc (true);
+  perf_report ("malloc-alloc-free",
+               timer_cycles_to_ns (timer_cycles () - start)
+               / (ROUND_CNT * OBJ_CNT), "ns");
+
+  kmem_cache_destroy (cache);
+}
+
+static void
+obj_ctor (void *obj_)
+{
+  struct obj *obj = obj_;
+  obj->magic = OBJ_MAGIC;
+}
+
+/* Allocates OBJ_CNT objects from CACHE into OBJS, checking that
+   each one is constructed.  If TIMED, frees them again. */
+static void
+run_slab (struct kmem_cache *cache, bool timed)
+{
+  int i;
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      struct obj *obj = objs[i] = kmem_cache_alloc (cache);
+      if (obj == NULL)
+        fail ("kmem_cache_alloc failed");
+      if (obj->magic != OBJ_MAGIC)
+        fail ("object %d not constructed", i);
+    }
+  if (timed)
+    for (i = 0; i < OBJ_CNT; i++)
+      kmem_cache_free (cache, objs[i]);
+}
+
+/* Allocates OBJ_CNT objects with malloc() into OBJS.  If TIMED,
+   frees them again. */
+static void
+run_malloc (bool timed)
+{
+  int i;
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = malloc (sizeof (struct obj));
+      if (objs[i] == NULL)
+        fail ("malloc failed");
+    }
+  if (timed)
+    for (i = 0; i < OBJ_CNT; i++)
+      free (objs[i]);
+}
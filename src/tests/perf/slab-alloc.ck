@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+check_perf ({'slab-pages' => 40,
+	     'malloc-pages' => 100,
+	     'slab-alloc-free' => 2_000_000,
+	     'malloc-alloc-free' => 2_000_000});
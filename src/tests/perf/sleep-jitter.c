@@ -0,0 +1,63 @@
+/* Measures how late timer_sleep() wakes its callers.
+
+   THREAD_CNT threads each sleep for SLEEP_TICKS ticks ROUNDS
+   times, starting just after a tick boundary.  The difference
+   between the time each sleep took and SLEEP_TICKS ticks is its
+   jitter. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define ROUNDS 10
+#define SLEEP_TICKS 3
+#define TICK_NS (1000000000 / TIMER_FREQ)
+
+static struct semaphore done;
+static struct lock totals_lock;
+static int64_t jitter_sum, jitter_max;
+
+static void sleeper (void *);
+
+void
+test_sleep_jitter (void)
+{
+  int i;
+
+  sema_init (&done, 0);
+  lock_init (&totals_lock);
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_create ("sleeper", PRI_DEFAULT + 1, sleeper, NULL);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  perf_report ("jitter-mean", jitter_sum / (THREAD_CNT * ROUNDS), "ns");
+  perf_report ("jitter-max", jitter_max, "ns");
+}
+
+static void
+sleeper (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      int64_t start, jitter;
+
+      timer_sleep (1);
+      start = timer_ns ();
+      timer_sleep (SLEEP_TICKS);
+      jitter = timer_ns () - start - SLEEP_TICKS * TICK_NS;
+      if (jitter < 0)
+        jitter = -jitter;
+
+      lock_acquire (&totals_lock);
+      jitter_sum += jitter;
+      if (jitter > jitter_max)
+        jitter_max = jitter;
+      lock_release (&totals_lock);
+    }
+  sema_up (&done);
+}
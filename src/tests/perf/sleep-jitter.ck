@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+check_perf ({'jitter-mean' => 10_000_000, 'jitter-max' => 20_000_000});
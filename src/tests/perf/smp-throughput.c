@@ -0,0 +1,83 @@
+/* Measures how well CPU-bound threads spread across CPUs.
+
+   Each of THREAD_CNT threads busy-waits for WORK_MS ms, which is
+   a fixed amount of work.  The main thread times one such thread
+   alone, then all of them at once.  With P of them able to run
+   in parallel, all of them should take THREAD_CNT / P times as
+   long as one.  Reports the time taken as a percentage of that,
+   so 100 is perfect scaling, and the number of CPUs the threads
+   ran on.  Run with more than one CPU, e.g. "pintos --smp=4". */
+
+#include "tests/perf/perf.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define WORK_MS 100
+
+static struct semaphore done;
+static unsigned cpus_used;      /* Bit N set if a worker ran on cpus[N]. */
+
+static thread_func worker;
+static int64_t run (int thread_cnt);
+
+void
+test_smp_throughput (void)
+{
+  int64_t serial_ns, parallel_ns;
+  int online = 0;
+  int used = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].online)
+      online++;
+  if (online > THREAD_CNT)
+    online = THREAD_CNT;
+
+  sema_init (&done, 0);
+  serial_ns = run (1);
+  cpus_used = 0;
+  parallel_ns = run (THREAD_CNT);
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus_used & (1u << i))
+      used++;
+
+  perf_report ("serial", serial_ns, "ns");
+  perf_report ("parallel", parallel_ns, "ns");
+  perf_report ("scaling-pct",
+               parallel_ns * online * 100 / (serial_ns * THREAD_CNT), "%");
+  perf_report ("cpus-used", used, "cpus");
+}
+
+/* Runs THREAD_CNT workers at once and returns how long they took,
+   in nanoseconds. */
+static int64_t
+run (int thread_cnt)
+{
+  uint64_t start = timer_cycles ();
+  int i;
+
+  for (i = 0; i < thread_cnt; i++)
+    thread_create ("worker", PRI_DEFAULT, worker, NULL);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&done);
+  return timer_cycles_to_ns (timer_cycles () - start);
+}
+
+static void
+worker (void *aux UNUSED)
+{
+  enum intr_level old_level;
+
+  timer_mdelay (WORK_MS);
+
+  old_level = intr_disable ();
+  cpus_used |= 1u << cpu_current ()->id;
+  intr_set_level (old_level);
+
+  sema_up (&done);
+}
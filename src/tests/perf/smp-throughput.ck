@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::perf::perf;
+# The workers must run in parallel on as many CPUs as there are,
+# at no more than 1.5 times the ideal time.
+check_perf ({'serial' => 1_000_000_000,
+	     'parallel' => 2_000_000_000,
+	     'scaling-pct' => 150,
+	     'cpus-used' => 8});
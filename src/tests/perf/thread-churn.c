@@ -0,0 +1,40 @@
+/* Measures thread creation and exit throughput.
+
+   The main thread creates THREAD_CNT threads one at a time, each
+   at a higher priority so that it runs and exits at once, and
+   waits for each to finish before creating the next. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 500
+
+static struct semaphore done;
+
+static void child (void *);
+
+void
+test_thread_churn (void)
+{
+  uint64_t start;
+  int i;
+
+  sema_init (&done, 0);
+  start = timer_cycles ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      thread_create ("child", PRI_DEFAULT + 1, child, NULL);
+      sema_down (&done);
+    }
+  perf_report ("create-exit",
+               timer_cycles_to_ns (timer_cycles () - start) / THREAD_CNT,
+               "ns");
+}
+
+static void
+child (void *aux UNUSED)
+{
+  sema_up (&done);
+}
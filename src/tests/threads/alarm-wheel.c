@@ -0,0 +1,139 @@
+/* Arms TIMER_CNT kernel timers with deadlines spread over
+   MAX_DELAY ticks, cancels every tenth one, and checks that each
+   of the rest fires exactly once, on its deadline.  At the same
+   time, SLEEPER_CNT threads sleep until deadlines of their own
+   and the test reports how late they woke up. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define TIMER_CNT 10000
+#define SLEEPER_CNT 64
+#define MAX_DELAY 600
+
+static struct timer_elem *timers;
+static char *fire_cnts;          /* Times each timer fired. */
+static int64_t start;            /* Earliest deadline. */
+static int late_cnt;             /* Timers that fired off deadline. */
+
+/* Sleeper results. */
+static struct semaphore sleepers_done;
+static struct lock sleeper_lock;
+static int64_t sleeper_total_lateness;
+static int64_t sleeper_max_lateness;
+static int sleeper_early_cnt;
+
+static timer_func timer_fired;
+static thread_func sleeper;
+
+void
+test_alarm_wheel (void)
+{
+  int cancel_cnt, fired_cnt;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  timers = malloc (sizeof *timers * TIMER_CNT);
+  fire_cnts = malloc (TIMER_CNT);
+  if (timers == NULL || fire_cnts == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  sema_init (&sleepers_done, 0);
+  lock_init (&sleeper_lock);
+  start = timer_ticks () + 50;
+
+  /* Arm timers, then cancel every tenth one. */
+  for (i = 0; i < TIMER_CNT; i++)
+    {
+      timers[i].pending = false;
+      fire_cnts[i] = 0;
+      timer_add (&timers[i], start + (i * 7919) % MAX_DELAY,
+                 timer_fired, (void *) i);
+    }
+  cancel_cnt = 0;
+  for (i = 0; i < TIMER_CNT; i += 10)
+    if (timer_cancel (&timers[i]))
+      cancel_cnt++;
+  if (timer_ticks () >= start)
+    fail ("arming timers took more than 50 ticks");
+  msg ("Armed %d timers, cancelled %d.", TIMER_CNT, cancel_cnt);
+
+  /* Start sleepers. */
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, (void *) i);
+    }
+
+  /* Wait for everything to finish. */
+  timer_sleep (start + MAX_DELAY + 10 - timer_ticks ());
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&sleepers_done);
+
+  fired_cnt = 0;
+  for (i = 0; i < TIMER_CNT; i++)
+    {
+      if (fire_cnts[i] > 1)
+        fail ("timer %d fired %d times", i, fire_cnts[i]);
+      else if (fire_cnts[i] == 1 && i % 10 == 0)
+        fail ("cancelled timer %d fired", i);
+      else if (fire_cnts[i] == 0 && i % 10 != 0)
+        fail ("timer %d never fired", i);
+      fired_cnt += fire_cnts[i];
+      if (timer_cancel (&timers[i]))
+        fail ("timer %d still pending after its deadline", i);
+    }
+  if (late_cnt != 0)
+    fail ("%d timers fired off their deadline", late_cnt);
+  msg ("%d timers fired, each on its deadline.", fired_cnt);
+
+  if (sleeper_early_cnt != 0)
+    fail ("%d sleepers woke up early", sleeper_early_cnt);
+  msg ("%d sleepers woke up, none early.", SLEEPER_CNT);
+  msg ("sleeper wakeup jitter: average %d/%d, maximum %d ticks.",
+       (int) sleeper_total_lateness, SLEEPER_CNT, (int) sleeper_max_lateness);
+
+  free (fire_cnts);
+  free (timers);
+}
+
+/* Timer function.  Runs in the timer interrupt handler. */
+static void
+timer_fired (void *aux)
+{
+  int i = (int) aux;
+
+  fire_cnts[i]++;
+  if (timer_ticks () != timers[i].end_time)
+    late_cnt++;
+}
+
+/* Sleeps until a fixed deadline and records how late it woke up. */
+static void
+sleeper (void *aux)
+{
+  int i = (int) aux;
+  int64_t deadline = start + (i * 37) % MAX_DELAY;
+  int64_t lateness;
+
+  timer_sleep (deadline - timer_ticks ());
+  lateness = timer_ticks () - deadline;
+
+  lock_acquire (&sleeper_lock);
+  if (lateness < 0)
+    sleeper_early_cnt++;
+  sleeper_total_lateness += lateness;
+  if (lateness > sleeper_max_lateness)
+    sleeper_max_lateness = lateness;
+  lock_release (&sleeper_lock);
+
+  sema_up (&sleepers_done);
+}
@@ -0,0 +1,94 @@
+/* Checks that kernel threads keep their own x87 and SSE state
+   across context switches.
+
+   THREAD_CNT threads each keep one running sum on the x87
+   register stack and another in an SSE register, adding their
+   own increment ADD_CNT times.  They yield after every few
+   additions and spin in between, long enough to be preempted by
+   the timer now and then, so the FPU changes hands many times in
+   the middle of every sum.  The kernel is compiled without
+   floating point, so nothing but the lazy FPU switching in
+   threads/fpu.c touches these registers between the inline
+   assembly statements below. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4
+#define ADD_CNT 500
+
+struct fpu_info
+  {
+    int increment;              /* Added to both sums each time. */
+    int x87_sum;                /* Final x87 sum. */
+    int sse_sum;                /* Final SSE sum. */
+    struct semaphore *done;     /* Upped when finished. */
+  };
+
+static thread_func fpu_thread;
+
+void
+test_fpu_threads (void)
+{
+  struct fpu_info info[THREAD_CNT];
+  struct semaphore done;
+  int i;
+
+  if (!fpu_available ())
+    fail ("no FPU");
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      info[i].increment = i + 1;
+      info[i].done = &done;
+      snprintf (name, sizeof name, "fpu %d", i);
+      thread_create (name, PRI_DEFAULT, fpu_thread, &info[i]);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int expected = info[i].increment * ADD_CNT;
+
+      if (info[i].x87_sum != expected || info[i].sse_sum != expected)
+        fail ("thread %d: x87 sum %d, SSE sum %d, expected %d",
+              i, info[i].x87_sum, info[i].sse_sum, expected);
+      msg ("thread %d: both sums are %d", i, expected);
+    }
+}
+
+static void
+fpu_thread (void *info_)
+{
+  struct fpu_info *info = info_;
+  int zero = 0;
+  int i;
+
+  asm volatile ("fildl %0" : : "m" (zero));
+  asm volatile ("xorps %%xmm0, %%xmm0" : :);
+  for (i = 0; i < ADD_CNT; i++)
+    {
+      volatile int spin;
+
+      asm volatile ("fiaddl %0" : : "m" (info->increment));
+      asm volatile ("cvtsi2ss %0, %%xmm1\n\t"
+                    "addss %%xmm1, %%xmm0" : : "m" (info->increment));
+
+      for (spin = 0; spin < 2000; spin++)
+        continue;
+      if (i % 8 == 0)
+        thread_yield ();
+    }
+  asm volatile ("fistpl %0" : "=m" (info->x87_sum));
+  asm volatile ("cvttss2si %%xmm0, %0" : "=r" (info->sse_sum));
+
+  sema_up (info->done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-threads) begin
+(fpu-threads) thread 0: both sums are 500
+(fpu-threads) thread 1: both sums are 1000
+(fpu-threads) thread 2: both sums are 1500
+(fpu-threads) thread 3: both sums are 2000
+(fpu-threads) end
+EOF
+pass;
@@ -0,0 +1,79 @@
+/* Checks futex_wait() and futex_wake() on futexes in a page from
+   the page allocator.
+
+   futex_wait() must return at once if the futex no longer holds
+   the expected value, and time out if nobody wakes it.  Then
+   WAITER_CNT threads wait on one futex.  They outrank the main
+   thread, so each is asleep by the time thread_create() returns,
+   and each runs as soon as it is woken.  A wakeup on another
+   futex in the same page must not wake them, and waking two and
+   then the rest must wake them oldest first. */
+
+#include <syscall-nr.h>
+#include "tests/threads/tests.h"
+#include "threads/futex.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WAITER_CNT 5
+
+static int *futexes;            /* Futexes, in a page of their own. */
+static int order[WAITER_CNT];   /* Waiters, in the order they woke. */
+static int order_cnt;
+static int results[WAITER_CNT]; /* futex_wait() return values. */
+
+static thread_func waiter;
+
+void
+test_futex_wait_wake (void)
+{
+  int64_t start;
+  int i;
+
+  futexes = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
+  if (futex_wait (&futexes[0], 1, -1) != FUTEX_AGAIN)
+    fail ("futex_wait with stale value did not return at once");
+  if (futex_wait (&futexes[0], 0, 0) != FUTEX_TIMEDOUT)
+    fail ("futex_wait with zero timeout did not time out");
+  start = timer_ticks ();
+  if (futex_wait (&futexes[0], 0, 50) != FUTEX_TIMEDOUT)
+    fail ("futex_wait did not time out");
+  if (timer_elapsed (start) < 50 * TIMER_FREQ / 1000)
+    fail ("futex_wait timed out early");
+  if (futex_wake (&futexes[0], 1) != 0)
+    fail ("futex_wake woke a thread with no waiters");
+  msg ("Timeouts and stale values work.");
+
+  for (i = 0; i < WAITER_CNT; i++)
+    thread_create ("waiter", PRI_DEFAULT + 1, waiter, (void *) i);
+
+  if (futex_wake (&futexes[1], WAITER_CNT) != 0 || order_cnt != 0)
+    fail ("futex_wake woke waiters on another futex");
+  msg ("Waking another futex woke nobody.");
+
+  if (futex_wake (&futexes[0], 2) != 2 || order_cnt != 2)
+    fail ("futex_wake did not wake exactly 2 waiters");
+  if (futex_wake (&futexes[0], WAITER_CNT) != WAITER_CNT - 2
+      || order_cnt != WAITER_CNT)
+    fail ("futex_wake did not wake the other waiters");
+
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      if (results[i] != 0)
+        fail ("waiter %d: futex_wait returned %d", i, results[i]);
+      msg ("Waiter %d woke up.", order[i]);
+    }
+  palloc_free_page (futexes);
+}
+
+static void
+waiter (void *id_)
+{
+  int id = (int) id_;
+
+  results[id] = futex_wait (&futexes[0], 0, -1);
+  order[order_cnt++] = id;
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wait-wake) begin
+(futex-wait-wake) Timeouts and stale values work.
+(futex-wait-wake) Waking another futex woke nobody.
+(futex-wait-wake) Waiter 0 woke up.
+(futex-wait-wake) Waiter 1 woke up.
+(futex-wait-wake) Waiter 2 woke up.
+(futex-wait-wake) Waiter 3 woke up.
+(futex-wait-wake) Waiter 4 woke up.
+(futex-wait-wake) end
+EOF
+pass;
@@ -0,0 +1,84 @@
+/* Checks malloc()'s size classes and medium arenas.
+
+   Requests just over 1 kB and just over 4 kB must no longer be
+   rounded up to whole pages.  Then blocks of sizes from 1 byte to
+   20 kB, which covers every size class, the medium arenas, and
+   big blocks, are allocated, filled with a pattern, grown with
+   realloc(), checked, and freed in a scrambled order, so that
+   medium chunks are merged with free neighbors on either side. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+
+#define BLOCK_CNT 64
+
+static void *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+static void fill (int i);
+static void check (int i, size_t size);
+
+void
+test_malloc_classes (void)
+{
+  int i;
+
+  if (malloc_round_size (1100) > 1280)
+    fail ("1100-byte request rounded to %zu bytes", malloc_round_size (1100));
+  msg ("1100-byte request fits in 1280 bytes.");
+  if (malloc_round_size (4100) > 4200)
+    fail ("4100-byte request rounded to %zu bytes", malloc_round_size (4100));
+  msg ("4100-byte request takes less than two pages.");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      sizes[i] = 1 + (size_t) i * i * 5;
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc (%zu) failed", sizes[i]);
+      fill (i);
+    }
+  msg ("Allocated blocks of 1 to %zu bytes.", sizes[BLOCK_CNT - 1]);
+
+  for (i = 0; i < BLOCK_CNT; i += 3)
+    {
+      size_t old_size = sizes[i];
+      sizes[i] = old_size * 2;
+      blocks[i] = realloc (blocks[i], sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("realloc to %zu bytes failed", sizes[i]);
+      check (i, old_size);
+      fill (i);
+    }
+  msg ("Grew every third block.");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      int j = (i * 37) % BLOCK_CNT;
+      check (j, sizes[j]);
+      free (blocks[j]);
+    }
+  msg ("Checked and freed every block.");
+}
+
+/* Fills block I with a pattern. */
+static void
+fill (int i)
+{
+  memset (blocks[i], i, sizes[i]);
+}
+
+/* Checks that the first SIZE bytes of block I hold its
+   pattern. */
+static void
+check (int i, size_t size)
+{
+  const unsigned char *p = blocks[i];
+  size_t ofs;
+
+  for (ofs = 0; ofs < size; ofs++)
+    if (p[ofs] != i)
+      fail ("block %d (%zu bytes) corrupted at offset %zu", i, size, ofs);
+}
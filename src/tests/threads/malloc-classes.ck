@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-classes) begin
+(malloc-classes) 1100-byte request fits in 1280 bytes.
+(malloc-classes) 4100-byte request takes less than two pages.
+(malloc-classes) Allocated blocks of 1 to 19846 bytes.
+(malloc-classes) Grew every third block.
+(malloc-classes) Checked and freed every block.
+(malloc-classes) end
+EOF
+pass;
@@ -0,0 +1,102 @@
+/* Checks that periodic real-time threads are counted in the load
+   average under the MLFQS scheduler.
+
+   Periodic threads wait in a run queue of their own, apart from
+   the MLFQS ready lists, and the once a second decay rebuilds
+   only the ready lists.  Two periodic threads, taking 20% of the
+   CPU each, run here while the main thread spins for 10 seconds,
+   so that many decays happen while they come and go.  The number
+   of ready threads must never fall below 0, and the load average
+   must end up where one to three busy threads would put it (the
+   main thread, a periodic thread, and now and then a kernel
+   thread): between 0.15 and 0.46 after 10 seconds, as you can
+   verify:
+   perl -e '$a=(59*$a+3)/60 for 1..10;print "$a\n"' */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+struct periodic_info
+  {
+    int job_cnt;                /* # of jobs run. */
+    volatile bool *stop;        /* Exit at the next job once set. */
+    struct semaphore *done;     /* Upped when the thread exits. */
+  };
+
+static void periodic_job (void *);
+
+void
+test_mlfqs_periodic (void)
+{
+  struct periodic_info info[2];
+  struct semaphore done;
+  volatile bool stop = false;
+  int64_t start_time;
+  int load_avg;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&done, 0);
+  for (i = 0; i < 2; i++)
+    {
+      info[i].job_cnt = 0;
+      info[i].stop = &stop;
+      info[i].done = &done;
+    }
+
+  if (thread_create_periodic ("rt 10", 10, 2, periodic_job, &info[0])
+      == TID_ERROR
+      || thread_create_periodic ("rt 25", 25, 5, periodic_job, &info[1])
+      == TID_ERROR)
+    fail ("periodic thread refused");
+
+  msg ("spinning for 10 seconds, please wait...");
+  start_time = timer_ticks ();
+  while (timer_elapsed (start_time) < 10 * TIMER_FREQ)
+    {
+      enum intr_level old_level = intr_disable ();
+      int ready = ready_queue_length ();
+      intr_set_level (old_level);
+
+      if (ready < 0)
+        fail ("%d threads ready after %"PRId64" ticks",
+              ready, timer_elapsed (start_time));
+    }
+  load_avg = thread_get_load_avg ();
+
+  stop = true;
+  for (i = 0; i < 2; i++)
+    sema_down (&done);
+  for (i = 0; i < 2; i++)
+    if (info[i].job_cnt == 0)
+      fail ("periodic thread %d never ran", i);
+
+  if (load_avg < 15 || load_avg > 46)
+    fail ("load average is %d.%02d but should be between 0.15 and 0.46",
+          load_avg / 100, load_avg % 100);
+  msg ("load average is between 0.15 and 0.46");
+  pass ();
+}
+
+/* Runs one job of a periodic thread, which uses about half of
+   its budget. */
+static void
+periodic_job (void *info_)
+{
+  struct periodic_info *info = info_;
+
+  info->job_cnt++;
+  if (*info->stop)
+    {
+      sema_up (info->done);
+      thread_exit ();
+    }
+  timer_mdelay (5);
+}
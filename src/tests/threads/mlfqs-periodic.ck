@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs-periodic) begin
+(mlfqs-periodic) spinning for 10 seconds, please wait...
+(mlfqs-periodic) load average is between 0.15 and 0.46
+(mlfqs-periodic) PASS
+(mlfqs-periodic) end
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Measures the longest timer interrupt while many threads are
+   blocked under the MLFQS.
+
+   The main thread starts THREAD_CNT threads that each block on a
+   semaphore, then spins for MEASURE_SECS seconds so that the
+   timer interrupt runs its once-per-second load average and
+   recent_cpu updates several times.  Blocked threads should not
+   make those updates any slower, so the longest interrupt is
+   reported for comparison between kernels.  Finally the main
+   thread wakes all the blocked threads and waits for them to
+   finish. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 600
+#define MEASURE_SECS 3
+
+static struct semaphore wakeup;
+static struct semaphore done;
+
+static void blocker (void *);
+
+void
+test_mlfqs_tick_cost (void)
+{
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&wakeup, 0);
+  sema_init (&done, 0);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "blocker %d", i);
+      thread_create (name, PRI_DEFAULT, blocker, NULL);
+    }
+  msg ("Started %d threads.", THREAD_CNT);
+
+  timer_reset_max_interrupt ();
+  start_time = timer_ticks ();
+  while (timer_elapsed (start_time) < MEASURE_SECS * TIMER_FREQ)
+    continue;
+  msg ("Spun for %d seconds.", MEASURE_SECS);
+  msg ("longest timer interrupt: %lld ns", timer_max_interrupt_ns ());
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_up (&wakeup);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  msg ("All %d threads finished.", THREAD_CNT);
+}
+
+static void
+blocker (void *aux UNUSED)
+{
+  sema_down (&wakeup);
+  sema_up (&done);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Interrupt latency varies from run to run, so just make sure it
+# was reported and leave it out of the comparison.
+fail "No interrupt latency report in output.\n"
+  if !grep (/longest timer interrupt/, @output);
+@output = grep (!/longest timer interrupt/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(mlfqs-tick-cost) begin
+(mlfqs-tick-cost) Started 600 threads.
+(mlfqs-tick-cost) Spun for 3 seconds.
+(mlfqs-tick-cost) All 600 threads finished.
+(mlfqs-tick-cost) end
+EOF
+pass;
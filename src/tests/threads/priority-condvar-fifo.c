@@ -0,0 +1,60 @@
+/* Tests that cond_broadcast() wakes up the threads waiting in
+   cond_wait() in the same order that cond_signal() would: by
+   priority, highest first, and in the order they started
+   waiting among threads of equal priority.
+
+   Twelve threads at three priorities wait in turn.  The main
+   thread then broadcasts at PRI_MAX, so that none of them runs
+   until all have been woken, and lowers its priority.  Threads
+   of equal priority run in the order they were woken. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 12
+
+static thread_func priority_condvar_fifo_thread;
+static struct lock lock;
+static struct condition condition;
+
+void
+test_priority_condvar_fifo (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&lock);
+  cond_init (&condition);
+
+  /* Each thread outranks us, so it is waiting by the time
+     thread_create() returns. */
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      int priority = PRI_DEFAULT + 1 + i % 3;
+      char name[16];
+      snprintf (name, sizeof name, "thread %d", i);
+      thread_create (name, priority, priority_condvar_fifo_thread, NULL);
+    }
+
+  thread_set_priority (PRI_MAX);
+  lock_acquire (&lock);
+  msg ("Broadcasting...");
+  cond_broadcast (&condition, &lock);
+  lock_release (&lock);
+  thread_set_priority (PRI_MIN);
+  msg ("All threads woke up.");
+}
+
+static void
+priority_condvar_fifo_thread (void *aux UNUSED)
+{
+  lock_acquire (&lock);
+  cond_wait (&condition, &lock);
+  msg ("%s (priority %d) woke up.", thread_name (), thread_get_priority ());
+  lock_release (&lock);
+}
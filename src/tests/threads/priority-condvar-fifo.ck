@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-condvar-fifo) begin
+(priority-condvar-fifo) Broadcasting...
+(priority-condvar-fifo) thread 2 (priority 34) woke up.
+(priority-condvar-fifo) thread 5 (priority 34) woke up.
+(priority-condvar-fifo) thread 8 (priority 34) woke up.
+(priority-condvar-fifo) thread 11 (priority 34) woke up.
+(priority-condvar-fifo) thread 1 (priority 33) woke up.
+(priority-condvar-fifo) thread 4 (priority 33) woke up.
+(priority-condvar-fifo) thread 7 (priority 33) woke up.
+(priority-condvar-fifo) thread 10 (priority 33) woke up.
+(priority-condvar-fifo) thread 0 (priority 32) woke up.
+(priority-condvar-fifo) thread 3 (priority 32) woke up.
+(priority-condvar-fifo) thread 6 (priority 32) woke up.
+(priority-condvar-fifo) thread 9 (priority 32) woke up.
+(priority-condvar-fifo) All threads woke up.
+(priority-condvar-fifo) end
+EOF
+pass;
@@ -0,0 +1,243 @@
+/* Stresses priority donation with a deep chain of nested
+   donations, with many threads donating to a single lock, and
+   with a single thread receiving donations through many locks.
+   Verifies the donated priorities along the way and reports the
+   average cost of each operation in CPU cycles.
+
+   The chain is DONATION_DEPTH_DEFAULT links long, so the
+   deepest donation must travel through every link to reach the
+   main thread. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define CHAIN_DEPTH DONATION_DEPTH_DEFAULT
+#define FANIN_CNT 32
+#define LOCK_CNT 16
+
+struct chain_link
+  {
+    struct lock *own;           /* Lock this thread holds. */
+    struct lock *next;          /* Lock this thread waits on. */
+  };
+
+struct fanin_test
+  {
+    struct lock lock;           /* Lock all the waiters want. */
+    int order[FANIN_CNT];       /* Priorities in acquisition order. */
+    int order_cnt;              /* Number of entries in order[]. */
+    int waiting_cnt;            /* Number of waiters that tried to acquire. */
+  };
+
+static thread_func chain_thread_func;
+static thread_func fanin_thread_func;
+static thread_func acquire_thread_func;
+static void test_chain (void);
+static void test_fanin (void);
+static void test_many_locks (void);
+
+void
+test_priority_donate_stress (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+  test_chain ();
+  test_fanin ();
+  test_many_locks ();
+}
+
+/* Builds a chain of CHAIN_DEPTH threads, each holding one lock
+   and waiting on the lock held by the previous one, with the main
+   thread at the far end. */
+static void
+test_chain (void)
+{
+  struct lock locks[CHAIN_DEPTH + 1];
+  struct chain_link links[CHAIN_DEPTH + 1];
+  uint64_t start, acquire_cycles;
+  int i;
+
+  for (i = 0; i <= CHAIN_DEPTH; i++)
+    lock_init (&locks[i]);
+  lock_acquire (&locks[0]);
+
+  acquire_cycles = 0;
+  for (i = 1; i <= CHAIN_DEPTH; i++)
+    {
+      char name[16];
+      int priority = PRI_MIN + i * 4;
+
+      links[i].own = &locks[i];
+      links[i].next = &locks[i - 1];
+      snprintf (name, sizeof name, "chain %d", i);
+
+      start = timer_cycles ();
+      thread_create (name, priority, chain_thread_func, &links[i]);
+      acquire_cycles += timer_cycles () - start;
+
+      if (thread_get_priority () != priority)
+        fail ("chain of %d: main has priority %d instead of %d.",
+              i, thread_get_priority (), priority);
+    }
+  msg ("Chain of %d donations reached main with priority %d.",
+       CHAIN_DEPTH, thread_get_priority ());
+
+  start = timer_cycles ();
+  lock_release (&locks[0]);
+  msg ("chain: %"PRIu64" cycles per blocking acquire, "
+       "%"PRIu64" cycles per release.",
+       acquire_cycles / CHAIN_DEPTH, (timer_cycles () - start) / CHAIN_DEPTH);
+  msg ("Chain unwound, main has priority %d.", thread_get_priority ());
+}
+
+static void
+chain_thread_func (void *link_)
+{
+  struct chain_link *link = link_;
+
+  lock_acquire (link->own);
+  lock_acquire (link->next);
+  lock_release (link->next);
+  lock_release (link->own);
+}
+
+/* Has FANIN_CNT threads of distinct priorities donate to the main
+   thread through one lock.  They are created in ascending priority
+   order, so that each one is above the priority donated by the
+   ones before it, preempts the main thread, and blocks on the
+   lock. */
+static void
+test_fanin (void)
+{
+  struct fanin_test test;
+  uint64_t start, acquire_cycles;
+  int max_priority = PRI_MIN;
+  int i;
+
+  lock_init (&test.lock);
+  test.order_cnt = 0;
+  test.waiting_cnt = 0;
+  lock_acquire (&test.lock);
+
+  acquire_cycles = 0;
+  for (i = 0; i < FANIN_CNT; i++)
+    {
+      char name[16];
+      int priority = PRI_MIN + 1 + i;
+
+      if (priority > max_priority)
+        max_priority = priority;
+      snprintf (name, sizeof name, "fanin %d", i);
+
+      start = timer_cycles ();
+      thread_create (name, priority, fanin_thread_func, &test);
+      acquire_cycles += timer_cycles () - start;
+
+      if (test.waiting_cnt != i + 1)
+        fail ("fan-in of %d: only %d waiters blocked on the lock.",
+              i + 1, test.waiting_cnt);
+      if (thread_get_priority () != max_priority)
+        fail ("fan-in of %d: main has priority %d instead of %d.",
+              i + 1, thread_get_priority (), max_priority);
+    }
+  if (test.waiting_cnt != FANIN_CNT || test.order_cnt != 0)
+    fail ("%d waiters blocked and %d acquired the lock before release.",
+          test.waiting_cnt, test.order_cnt);
+  msg ("Fan-in of %d waiters donated priority %d.",
+       FANIN_CNT, thread_get_priority ());
+
+  start = timer_cycles ();
+  lock_release (&test.lock);
+  msg ("fan-in: %"PRIu64" cycles per blocking acquire, "
+       "%"PRIu64" cycles per handoff.",
+       acquire_cycles / FANIN_CNT, (timer_cycles () - start) / FANIN_CNT);
+
+  if (test.order_cnt != FANIN_CNT)
+    fail ("only %d of %d waiters acquired the lock.",
+          test.order_cnt, FANIN_CNT);
+  for (i = 1; i < FANIN_CNT; i++)
+    if (test.order[i] >= test.order[i - 1])
+      fail ("waiter with priority %d ran after one with priority %d.",
+            test.order[i - 1], test.order[i]);
+  msg ("Waiters acquired the lock in priority order.");
+}
+
+static void
+fanin_thread_func (void *test_)
+{
+  struct fanin_test *test = test_;
+
+  test->waiting_cnt++;
+  lock_acquire (&test->lock);
+  test->order[test->order_cnt++] = thread_get_priority ();
+  lock_release (&test->lock);
+}
+
+/* Has the main thread hold LOCK_CNT locks, each with one waiter,
+   and checks its priority as it releases them one at a time in
+   scrambled order.  The waiters are created in ascending priority
+   order, so that each one preempts the main thread and blocks. */
+static void
+test_many_locks (void)
+{
+  struct lock locks[LOCK_CNT];
+  int priorities[LOCK_CNT];
+  uint64_t start, release_cycles;
+  int i, j;
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      lock_init (&locks[i]);
+      lock_acquire (&locks[i]);
+    }
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      char name[16];
+
+      priorities[i] = PRI_MIN + 1 + i;
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, priorities[i], acquire_thread_func, &locks[i]);
+      if (thread_get_priority () != priorities[i])
+        fail ("waiter %d did not block: main has priority %d instead of %d.",
+              i, thread_get_priority (), priorities[i]);
+    }
+  msg ("Main holds %d contended locks with priority %d.",
+       LOCK_CNT, thread_get_priority ());
+
+  release_cycles = 0;
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      int expected = PRI_MIN;
+
+      start = timer_cycles ();
+      lock_release (&locks[(i * 5) % LOCK_CNT]);
+      release_cycles += timer_cycles () - start;
+
+      for (j = i + 1; j < LOCK_CNT; j++)
+        if (priorities[(j * 5) % LOCK_CNT] > expected)
+          expected = priorities[(j * 5) % LOCK_CNT];
+      if (thread_get_priority () != expected)
+        fail ("after releasing %d locks main has priority %d instead of %d.",
+              i + 1, thread_get_priority (), expected);
+    }
+  msg ("many locks: %"PRIu64" cycles per release.",
+       release_cycles / LOCK_CNT);
+  msg ("Main released all locks with priority %d.", thread_get_priority ());
+}
+
+static void
+acquire_thread_func (void *lock_)
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  lock_release (lock);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts vary from run to run, so just make sure they
+# were reported and leave them out of the comparison.
+fail "No cost report in output.\n" if !grep (/cycles/, @output);
+@output = grep (!/cycles/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(priority-donate-stress) begin
+(priority-donate-stress) Chain of 8 donations reached main with priority 32.
+(priority-donate-stress) Chain unwound, main has priority 0.
+(priority-donate-stress) Fan-in of 32 waiters donated priority 32.
+(priority-donate-stress) Waiters acquired the lock in priority order.
+(priority-donate-stress) Main holds 16 contended locks with priority 16.
+(priority-donate-stress) Main released all locks with priority 0.
+(priority-donate-stress) end
+EOF
+pass;
@@ -0,0 +1,113 @@
+/* Checks periodic real-time threads.
+
+   Two periodic threads, with periods of 10 and 25 ticks, run
+   JOB_CNT jobs each while an ordinary thread at PRI_MAX spins.
+   Because periodic threads take precedence over all priorities,
+   every job should still start within its own period.
+
+   A third periodic thread that would commit more than the
+   admission limit of the CPU must be refused, and admitted once
+   the first two have exited. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define JOB_CNT 20
+
+struct periodic_info
+  {
+    int64_t period;             /* Period, in ticks. */
+    int job_cnt;                /* # of jobs started. */
+    int late_cnt;               /* # of jobs started outside their period. */
+    int64_t first_start;        /* Tick at which the first job started. */
+    struct semaphore *done;     /* Upped after the last job. */
+  };
+
+static void periodic_job (void *);
+static void spinner (void *);
+
+void
+test_rt_periodic (void)
+{
+  struct periodic_info info[3];
+  struct semaphore done;
+  int i;
+
+  sema_init (&done, 0);
+  for (i = 0; i < 3; i++)
+    {
+      info[i].period = i == 0 ? 10 : i == 1 ? 25 : 100;
+      info[i].job_cnt = info[i].late_cnt = 0;
+      info[i].first_start = 0;
+      info[i].done = &done;
+    }
+
+  /* 20% and 20% of the CPU. */
+  if (thread_create_periodic ("rt 10", 10, 2, periodic_job, &info[0])
+      == TID_ERROR
+      || thread_create_periodic ("rt 25", 25, 5, periodic_job, &info[1])
+      == TID_ERROR)
+    fail ("periodic thread refused");
+  msg ("Admitted two periodic threads.");
+
+  /* Another 60% is too much. */
+  if (thread_create_periodic ("rt 100", 100, 60, periodic_job, &info[2])
+      != TID_ERROR)
+    fail ("periodic thread admitted past the limit");
+  msg ("Refused a third periodic thread.");
+
+  /* Runs until well after the last jobs. */
+  thread_create ("spinner", PRI_MAX, spinner, NULL);
+  msg ("Spinner finished.");
+
+  for (i = 0; i < 2; i++)
+    sema_down (&done);
+  for (i = 0; i < 2; i++)
+    msg ("Periodic thread %d ran %d jobs, %d late.",
+         i, info[i].job_cnt, info[i].late_cnt);
+
+  /* The first two have given their share back. */
+  info[2].job_cnt = JOB_CNT - 1;
+  if (thread_create_periodic ("rt 100", 100, 60, periodic_job, &info[2])
+      == TID_ERROR)
+    fail ("periodic thread refused after others exited");
+  sema_down (&done);
+  msg ("Admitted the third periodic thread after the others exited.");
+}
+
+/* Runs one job of a periodic thread. */
+static void
+periodic_job (void *info_)
+{
+  struct periodic_info *info = info_;
+  int64_t now = timer_ticks ();
+
+  if (info->job_cnt == 0)
+    info->first_start = now;
+  else
+    {
+      int64_t release = info->first_start + info->job_cnt * info->period;
+      if (now < release || now >= release + info->period)
+        info->late_cnt++;
+    }
+
+  timer_mdelay (5);
+  if (++info->job_cnt >= JOB_CNT)
+    {
+      sema_up (info->done);
+      thread_exit ();
+    }
+}
+
+static void
+spinner (void *aux UNUSED)
+{
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < 600)
+    continue;
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rt-periodic) begin
+(rt-periodic) Admitted two periodic threads.
+(rt-periodic) Refused a third periodic thread.
+(rt-periodic) Spinner finished.
+(rt-periodic) Periodic thread 0 ran 20 jobs, 0 late.
+(rt-periodic) Periodic thread 1 ran 20 jobs, 0 late.
+(rt-periodic) Admitted the third periodic thread after the others exited.
+(rt-periodic) end
+EOF
+pass;
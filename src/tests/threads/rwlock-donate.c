@@ -0,0 +1,60 @@
+/* The main thread and a "reader" thread both hold a
+   readers-writer lock for reading when a higher-priority
+   "writer" thread blocks trying to write it.  The writer should
+   donate its priority to both readers, and get the lock as soon
+   as the last of them releases it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static struct rwlock rw;
+static struct semaphore go;
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_donate (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rw_init (&rw);
+  sema_init (&go, 0);
+  rw_read_acquire (&rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, NULL);
+  thread_create ("writer", PRI_DEFAULT + 10, writer_thread_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  sema_up (&go);
+  rw_read_release (&rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+reader_thread_func (void *aux UNUSED)
+{
+  rw_read_acquire (&rw);
+  msg ("reader: got the lock for reading");
+  sema_down (&go);
+  msg ("reader: should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  rw_read_release (&rw);
+  msg ("reader: done");
+}
+
+static void
+writer_thread_func (void *aux UNUSED)
+{
+  rw_write_acquire (&rw);
+  msg ("writer: got the lock for writing");
+  rw_write_release (&rw);
+  msg ("writer: done");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) reader: got the lock for reading
+(rwlock-donate) Main thread should have priority 41.  Actual priority: 41.
+(rwlock-donate) reader: should have priority 41.  Actual priority: 41.
+(rwlock-donate) writer: got the lock for writing
+(rwlock-donate) writer: done
+(rwlock-donate) reader: done
+(rwlock-donate) Main thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,115 @@
+/* Stresses readers-writer locks with READER_CNT readers and
+   WRITER_CNT writers at mixed priorities, each of which takes
+   the lock ITER_CNT times.  Holders sleep or yield inside their
+   critical sections so that the threads interleave, and some of
+   the acquisitions go through the try variants.  Checks that no
+   reader ever overlaps a writer, that writers exclude each
+   other, and that readers do overlap each other. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 8
+#define WRITER_CNT 4
+#define ITER_CNT 200
+
+static struct rwlock rw;
+static struct semaphore done;
+
+/* Protected by RW. */
+static int active_readers;      /* # of threads reading now. */
+static int active_writers;      /* # of threads writing now. */
+static int max_readers;         /* Largest value of active_readers. */
+static int write_cnt;           /* # of completed writes. */
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+static void linger (int i);
+
+void
+test_rwlock_stress (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rw_init (&rw);
+  sema_init (&done, 0);
+
+  thread_set_priority (PRI_MIN);
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT + i % 3, reader_thread_func, NULL);
+  for (i = 0; i < WRITER_CNT; i++)
+    thread_create ("writer", PRI_DEFAULT + i % 3, writer_thread_func, NULL);
+  for (i = 0; i < READER_CNT + WRITER_CNT; i++)
+    sema_down (&done);
+  thread_set_priority (PRI_DEFAULT);
+
+  if (write_cnt != WRITER_CNT * ITER_CNT)
+    fail ("%d writes completed, expected %d", write_cnt,
+          WRITER_CNT * ITER_CNT);
+  if (max_readers < 2)
+    fail ("readers never overlapped");
+  msg ("%d readers and %d writers finished %d iterations each.",
+       READER_CNT, WRITER_CNT, ITER_CNT);
+}
+
+static void
+reader_thread_func (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      if (i % 5 != 0 || !rw_read_try_acquire (&rw))
+        rw_read_acquire (&rw);
+      if (active_writers != 0)
+        fail ("reader overlapped a writer");
+      if (++active_readers > max_readers)
+        max_readers = active_readers;
+      linger (i);
+      if (active_writers != 0)
+        fail ("writer started while reading");
+      active_readers--;
+      rw_read_release (&rw);
+    }
+  sema_up (&done);
+}
+
+static void
+writer_thread_func (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      if (i % 5 != 0 || !rw_write_try_acquire (&rw))
+        rw_write_acquire (&rw);
+      if (active_readers != 0 || active_writers != 0)
+        fail ("writer overlapped another holder");
+      active_writers++;
+      linger (i);
+      if (active_readers != 0 || active_writers != 1)
+        fail ("another holder started while writing");
+      write_cnt++;
+      active_writers--;
+      rw_write_release (&rw);
+    }
+  sema_up (&done);
+}
+
+/* Lets other threads run in the middle of iteration I's critical
+   section, by sleeping or by yielding. */
+static void
+linger (int i)
+{
+  if (i % 4 == 0)
+    timer_sleep (1);
+  else
+    thread_yield ();
+}
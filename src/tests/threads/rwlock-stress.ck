@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-stress) begin
+(rwlock-stress) 8 readers and 4 writers finished 200 iterations each.
+(rwlock-stress) end
+EOF
+pass;
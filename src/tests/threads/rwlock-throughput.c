@@ -0,0 +1,105 @@
+/* Compares the throughput of readers-writer locks against plain
+   locks at several ratios of reads to writes.
+
+   For each ratio, WORKER_CNT threads repeatedly take the lock
+   and sleep for a tick while holding it, as a thread would while
+   waiting for a disk, for MEASURE_SECS seconds.  A plain lock
+   lets only one of them make progress at a time, but a
+   readers-writer lock lets the readers sleep side by side, so it
+   should complete more operations the more of them are reads. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WORKER_CNT 8
+#define MEASURE_SECS 1
+
+static const int read_pcts[] = {100, 90, 50};
+#define READ_PCT_CNT (sizeof read_pcts / sizeof *read_pcts)
+
+static struct lock lock;
+static struct rwlock rw;
+static bool use_rw;             /* Use RW rather than LOCK? */
+static int read_pct;            /* Percentage of operations that read. */
+static volatile bool stop;      /* Set when the workers should stop. */
+static int op_cnt;              /* # of operations completed. */
+static struct semaphore done;
+
+static thread_func worker;
+static int measure (bool use_rw, int read_pct);
+
+void
+test_rwlock_throughput (void)
+{
+  size_t i;
+
+  lock_init (&lock);
+  rw_init (&rw);
+  sema_init (&done, 0);
+
+  for (i = 0; i < READ_PCT_CNT; i++)
+    {
+      int pct = read_pcts[i];
+
+      msg ("lock, %d%% reads: %d ops/s", pct, measure (false, pct));
+      msg ("rwlock, %d%% reads: %d ops/s", pct, measure (true, pct));
+    }
+  msg ("Finished all measurements.");
+}
+
+/* Runs WORKER_CNT workers for MEASURE_SECS seconds, using a
+   readers-writer lock if USE_RW_ is true and a plain lock
+   otherwise, with READ_PCT_ percent of the operations reading.
+   Returns the number of operations per second. */
+static int
+measure (bool use_rw_, int read_pct_)
+{
+  int i;
+
+  use_rw = use_rw_;
+  read_pct = read_pct_;
+  stop = false;
+  op_cnt = 0;
+
+  for (i = 0; i < WORKER_CNT; i++)
+    thread_create ("worker", PRI_DEFAULT, worker, NULL);
+  timer_sleep (MEASURE_SECS * TIMER_FREQ);
+  stop = true;
+  for (i = 0; i < WORKER_CNT; i++)
+    sema_down (&done);
+
+  return op_cnt / MEASURE_SECS;
+}
+
+static void
+worker (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; !stop; i++)
+    {
+      bool read = i % 10 < read_pct / 10;
+
+      if (!use_rw)
+        lock_acquire (&lock);
+      else if (read)
+        rw_read_acquire (&rw);
+      else
+        rw_write_acquire (&rw);
+
+      timer_sleep (1);
+      op_cnt++;
+
+      if (!use_rw)
+        lock_release (&lock);
+      else if (read)
+        rw_read_release (&rw);
+      else
+        rw_write_release (&rw);
+    }
+  sema_up (&done);
+}
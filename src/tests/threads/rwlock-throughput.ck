@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Throughput varies from run to run, so just make sure it was
+# reported and leave it out of the comparison.
+fail "Missing throughput report in output.\n"
+  if grep (/ops\/s/, @output) != 6;
+@output = grep (!/ops\/s/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(rwlock-throughput) begin
+(rwlock-throughput) Finished all measurements.
+(rwlock-throughput) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* Measures the cost of sema_up() against the number of threads
+   waiting on the semaphore.
+
+   For each waiter count N, N threads at priorities above the
+   main thread's block on a semaphore.  The main thread then
+   raises itself to PRI_MAX, so that none of the waiters it wakes
+   can run yet, and times N calls to sema_up(), each of which
+   wakes the highest-priority waiter left.  Finally it lowers its
+   priority again to let the waiters finish.
+
+   With the waiters kept in priority order, the cost per release
+   should grow only logarithmically with N. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static const int waiter_cnts[] = {1, 8, 64, 256};
+#define WAITER_CNT_CNT (sizeof waiter_cnts / sizeof *waiter_cnts)
+
+static struct semaphore sema;
+static struct semaphore finished;
+
+static void waiter (void *);
+
+void
+test_sema_release_cost (void)
+{
+  size_t i;
+
+  sema_init (&sema, 0);
+  sema_init (&finished, 0);
+
+  for (i = 0; i < WAITER_CNT_CNT; i++)
+    {
+      int cnt = waiter_cnts[i];
+      uint64_t start, cycles;
+      int j;
+
+      /* Each waiter runs right away and blocks on SEMA. */
+      for (j = 0; j < cnt; j++)
+        thread_create ("waiter", PRI_DEFAULT + 1 + j % 16, waiter, NULL);
+
+      thread_set_priority (PRI_MAX);
+      start = timer_cycles ();
+      for (j = 0; j < cnt; j++)
+        sema_up (&sema);
+      cycles = timer_cycles () - start;
+      thread_set_priority (PRI_DEFAULT);
+
+      for (j = 0; j < cnt; j++)
+        sema_down (&finished);
+      msg ("%d waiters: %"PRId64" ns per release",
+           cnt, timer_cycles_to_ns (cycles) / cnt);
+    }
+  msg ("Released all waiters.");
+}
+
+static void
+waiter (void *aux UNUSED)
+{
+  sema_down (&sema);
+  sema_up (&finished);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary from run to run, so just make sure they were
+# reported and leave them out of the comparison.
+fail "Missing release cost report in output.\n"
+  if grep (/ns per release/, @output) != 4;
+@output = grep (!/ns per release/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(sema-release-cost) begin
+(sema-release-cost) Released all waiters.
+(sema-release-cost) end
+EOF
+pass;
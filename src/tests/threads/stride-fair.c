@@ -0,0 +1,105 @@
+/* Checks that the stride scheduler shares out the CPU in
+   proportion to tickets, that is, to priority.
+
+   The stride-fair-2 test runs 2 threads at the same priority,
+   which should receive 1,500 ticks each over 30 seconds.
+
+   The stride-fair-3 test runs 3 threads at priorities 9, 19,
+   and 29, which hold 10, 20, and 30 tickets and so should
+   receive 500, 1,000, and 1,500 ticks, respectively, over 30
+   seconds.
+
+   Each thread sleeps until 5 seconds in, so that they all start
+   competing together, then spins for 30 seconds counting the
+   timer ticks during which it ran.  The main thread, which
+   sleeps meanwhile, holds no tickets while blocked. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void test_stride_fair (int thread_cnt, int priority_min,
+                              int priority_step);
+
+void
+test_stride_fair_2 (void)
+{
+  test_stride_fair (2, PRI_DEFAULT, 0);
+}
+
+void
+test_stride_fair_3 (void)
+{
+  test_stride_fair (3, 9, 10);
+}
+
+#define MAX_THREAD_CNT 20
+
+struct thread_info
+  {
+    int64_t start_time;
+    int tick_count;
+  };
+
+static void load_thread (void *aux);
+
+static void
+test_stride_fair (int thread_cnt, int priority_min, int priority_step)
+{
+  struct thread_info info[MAX_THREAD_CNT];
+  int64_t start_time;
+  int priority;
+  int i;
+
+  ASSERT (thread_stride);
+  ASSERT (thread_cnt <= MAX_THREAD_CNT);
+  ASSERT (priority_min >= PRI_MIN);
+  ASSERT (priority_step >= 0);
+  ASSERT (priority_min + priority_step * (thread_cnt - 1) <= PRI_MAX);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", thread_cnt);
+  priority = priority_min;
+  for (i = 0; i < thread_cnt; i++)
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tick_count = 0;
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, priority, load_thread, ti);
+
+      priority += priority_step;
+    }
+  msg ("Starting threads took %"PRId64" ticks.", timer_elapsed (start_time));
+
+  msg ("Sleeping 40 seconds to let threads run, please wait...");
+  timer_sleep (40 * TIMER_FREQ);
+
+  for (i = 0; i < thread_cnt; i++)
+    msg ("Thread %d received %d ticks.", i, info[i].tick_count);
+}
+
+static void
+load_thread (void *ti_)
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 5 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 30 * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time)
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
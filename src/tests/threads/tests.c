@@ -1,4 +1,5 @@
 #include "tests/threads/tests.h"
+#include "tests/perf/perf.h"
 #include <debug.h>
 #include <string.h>
 #include <stdio.h>
@@ -17,6 +18,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-wheel", test_alarm_wheel},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,10 +27,12 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-stress", test_priority_donate_stress},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-condvar-fifo", test_priority_condvar_fifo},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +42,36 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-tick-cost", test_mlfqs_tick_cost},
+    {"mlfqs-periodic", test_mlfqs_periodic},
+    {"stride-fair-2", test_stride_fair_2},
+    {"stride-fair-3", test_stride_fair_3},
+    {"rt-periodic", test_rt_periodic},
+    {"sema-release-cost", test_sema_release_cost},
+    {"rwlock-donate", test_rwlock_donate},
+    {"rwlock-stress", test_rwlock_stress},
+    {"rwlock-throughput", test_rwlock_throughput},
+    {"workqueue", test_workqueue},
+    {"thread-create-rate", test_thread_create_rate},
+    {"thread-stats", test_thread_stats},
+    {"malloc-classes", test_malloc_classes},
+    {"fpu-threads", test_fpu_threads},
+    {"futex-wait-wake", test_futex_wait_wake},
+
+    /* Benchmarks in tests/perf. */
+    {"ctx-switch", test_ctx_switch},
+    {"lock-handoff", test_lock_handoff},
+    {"sleep-jitter", test_sleep_jitter},
+    {"thread-churn", test_thread_churn},
+    {"palloc-random", test_palloc_random},
+    {"palloc-zero", test_palloc_zero},
+    {"slab-alloc", test_slab_alloc},
+    {"malloc-threads", test_malloc_threads},
+    {"mlfqs-tick-10", test_mlfqs_tick_10},
+    {"mlfqs-tick-100", test_mlfqs_tick_100},
+    {"mlfqs-tick-1000", test_mlfqs_tick_1000},
+    {"mlfqs-decay-latency", test_mlfqs_decay_latency},
+    {"smp-throughput", test_smp_throughput},
   };
 
 static const char *test_name;
@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_wheel;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,10 +20,12 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_stress;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_condvar_fifo;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +35,21 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_tick_cost;
+extern test_func test_mlfqs_periodic;
+extern test_func test_stride_fair_2;
+extern test_func test_stride_fair_3;
+extern test_func test_rt_periodic;
+extern test_func test_sema_release_cost;
+extern test_func test_rwlock_donate;
+extern test_func test_rwlock_stress;
+extern test_func test_rwlock_throughput;
+extern test_func test_workqueue;
+extern test_func test_thread_create_rate;
+extern test_func test_thread_stats;
+extern test_func test_malloc_classes;
+extern test_func test_fpu_threads;
+extern test_func test_futex_wait_wake;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
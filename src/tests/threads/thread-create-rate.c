@@ -0,0 +1,49 @@
+/* Measures how fast threads can be created and torn down.
+
+   The main thread creates THREAD_CNT short-lived threads one at
+   a time, waiting for each to finish before creating the next,
+   and reports the number of threads created and joined per
+   second.  Each dead thread's page should be recycled for the
+   next one through the thread page cache. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 2000
+
+static struct semaphore done;
+
+static thread_func child;
+
+void
+test_thread_create_rate (void)
+{
+  uint64_t start, cycles;
+  int i;
+
+  sema_init (&done, 0);
+
+  start = timer_cycles ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      if (thread_create ("child", PRI_DEFAULT, child, NULL) == TID_ERROR)
+        fail ("thread_create failed after %d threads", i);
+      sema_down (&done);
+    }
+  cycles = timer_cycles () - start;
+
+  msg ("Created and joined %d threads.", THREAD_CNT);
+  msg ("%"PRId64" threads per second",
+       THREAD_CNT * 1000000000LL / timer_cycles_to_ns (cycles));
+}
+
+static void
+child (void *aux UNUSED)
+{
+  sema_up (&done);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The rate varies from run to run, so just make sure it was
+# reported and leave it out of the comparison.
+fail "Missing thread creation rate in output.\n"
+  if !grep (/threads per second/, @output);
+@output = grep (!/threads per second/, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(thread-create-rate) begin
+(thread-create-rate) Created and joined 2000 threads.
+(thread-create-rate) end
+EOF
+pass;
@@ -0,0 +1,90 @@
+/* Checks the per-thread CPU accounting.
+
+   A worker thread sleeps for SLEEP_TICKS timer ticks, so that it
+   is charged for blocked time, then spins for SPIN_TICKS, so that
+   it is charged for run time, and reads its own figures.  Then
+   the main thread spins for SPIN_TICKS while holding a lock that
+   a higher-priority thread waits on, so that it is charged for
+   donation time.  Each figure must cover at least 80% of the
+   interval that produced it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEP_TICKS 20
+#define SPIN_TICKS 10
+
+/* Minimum figure expected for an interval of TICKS ticks. */
+#define LOW_NS(TICKS) ((int64_t) (TICKS) * 1000000000 / TIMER_FREQ * 8 / 10)
+
+static struct thread_stats worker_stats;
+static struct semaphore worker_done;
+static struct lock lock;
+
+static void worker (void *);
+static void waiter (void *);
+static void spin (int64_t ticks);
+
+void
+test_thread_stats (void)
+{
+  struct thread_stats s;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&worker_done, 0);
+  thread_create ("worker", PRI_DEFAULT + 1, worker, NULL);
+  sema_down (&worker_done);
+
+  if (worker_stats.blocked_ns < LOW_NS (SLEEP_TICKS))
+    fail ("worker blocked for only %lld ns", worker_stats.blocked_ns);
+  msg ("Worker was charged for its sleep.");
+  if (worker_stats.run_ns < LOW_NS (SPIN_TICKS))
+    fail ("worker ran for only %lld ns", worker_stats.run_ns);
+  msg ("Worker was charged for its spin.");
+  if (worker_stats.voluntary_switches < 1)
+    fail ("worker never switched away voluntarily");
+  msg ("Worker's sleep counted as a voluntary switch.");
+
+  lock_init (&lock);
+  lock_acquire (&lock);
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter, NULL);
+  spin (SPIN_TICKS);
+  thread_get_stats (thread_current (), &s);
+  lock_release (&lock);
+
+  if (s.donated_ns < LOW_NS (SPIN_TICKS))
+    fail ("main thread held a donation for only %lld ns", s.donated_ns);
+  msg ("Main thread was charged for its donation.");
+}
+
+static void
+worker (void *aux UNUSED)
+{
+  timer_sleep (SLEEP_TICKS);
+  spin (SPIN_TICKS);
+  thread_get_stats (thread_current (), &worker_stats);
+  sema_up (&worker_done);
+}
+
+static void
+waiter (void *aux UNUSED)
+{
+  lock_acquire (&lock);
+  lock_release (&lock);
+}
+
+/* Busy-waits for TICKS timer ticks. */
+static void
+spin (int64_t ticks)
+{
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < ticks)
+    continue;
+}
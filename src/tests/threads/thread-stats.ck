@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-stats) begin
+(thread-stats) Worker was charged for its sleep.
+(thread-stats) Worker was charged for its spin.
+(thread-stats) Worker's sleep counted as a voluntary switch.
+(thread-stats) Main thread was charged for its donation.
+(thread-stats) end
+EOF
+pass;
@@ -0,0 +1,80 @@
+/* Checks that work items run in the order they were queued, that
+   an item queued twice before it starts runs once, that delayed
+   work waits for its timer, and that cancelled delayed work does
+   not run.  The work queue's thread has a lower priority than
+   the main thread, so nothing runs until the main thread waits
+   for it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define DELAY_TICKS 10
+
+static char order[8];           /* Names of the items run, in order. */
+static int order_cnt;
+static int64_t delayed_ran_at;  /* timer_ticks() when DELAYED ran. */
+
+static work_func record;
+static work_func record_time;
+
+void
+test_workqueue (void)
+{
+  struct workqueue *wq;
+  struct work a, b, c;
+  struct delayed_work delayed, cancelled;
+  int64_t start;
+
+  wq = workqueue_create ("test-wq", PRI_DEFAULT - 1);
+
+  work_init (&a, record, "a");
+  work_init (&b, record, "b");
+  work_init (&c, record, "c");
+  work_queue (wq, &a);
+  work_queue (wq, &b);
+  if (work_queue (wq, &a))
+    fail ("queued item a twice");
+  work_queue (wq, &c);
+  workqueue_flush (wq);
+  order[order_cnt] = '\0';
+  msg ("Items ran in order: %s", order);
+
+  delayed_work_init (&delayed, record_time, NULL);
+  delayed_work_init (&cancelled, record, "x");
+  start = timer_ticks ();
+  work_queue_delayed (wq, &delayed, DELAY_TICKS);
+  work_queue_delayed (wq, &cancelled, DELAY_TICKS);
+  if (!delayed_work_cancel (&cancelled))
+    fail ("could not cancel delayed work");
+  timer_sleep (DELAY_TICKS * 2);
+  work_flush (&delayed.work);
+  if (delayed_ran_at == 0)
+    fail ("delayed work did not run");
+  else if (delayed_ran_at - start < DELAY_TICKS)
+    fail ("delayed work ran after %lld ticks, expected %d",
+          delayed_ran_at - start, DELAY_TICKS);
+  msg ("Delayed work ran after at least %d ticks.", DELAY_TICKS);
+
+  order[order_cnt] = '\0';
+  msg ("Items ran in order: %s", order);
+}
+
+/* Appends the name of the work item, AUX, to ORDER. */
+static void
+record (void *aux)
+{
+  const char *name = aux;
+
+  order[order_cnt++] = name[0];
+}
+
+/* Records when the delayed work item ran. */
+static void
+record_time (void *aux UNUSED)
+{
+  delayed_ran_at = timer_ticks ();
+}
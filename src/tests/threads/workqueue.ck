@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Items ran in order: abc
+(workqueue) Delayed work ran after at least 10 ticks.
+(workqueue) Items ran in order: abc
+(workqueue) end
+EOF
+pass;
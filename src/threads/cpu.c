@@ -0,0 +1,466 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* See [MP] for the MultiProcessor Specification tables and
+   [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)" and 8.4 "Multiple-Processor (MP)
+   Initialization" for the local APIC and the startup protocol. */
+
+/* All the CPUs found at boot. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+
+/* If false, do not start the application processors. */
+bool cpu_smp = true;
+
+/* MP floating pointer structure. */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* Length in 16-byte units. */
+    uint8_t revision;           /* Spec revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    uint8_t type;               /* Default config type, if nonzero. */
+    uint8_t features[4];        /* Feature flags. */
+  };
+
+/* MP configuration table header. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of base table. */
+    uint8_t revision;           /* Spec revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    char oem[8];                /* OEM ID. */
+    char product[12];           /* Product ID. */
+    uint32_t oem_table;         /* OEM table pointer. */
+    uint16_t oem_length;        /* OEM table length. */
+    uint16_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t lapic_addr;        /* Physical address of local APIC. */
+    uint16_t ext_length;        /* Extended table length. */
+    uint8_t ext_checksum;       /* Extended table checksum. */
+    uint8_t reserved;
+  };
+
+/* MP configuration table processor entry. */
+struct mp_proc
+  {
+    uint8_t type;               /* MP_PROC. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;       /* Local APIC version. */
+    uint8_t flags;              /* MP_PROC_* flags. */
+    uint32_t signature;         /* CPU signature. */
+    uint32_t features;          /* CPUID feature flags. */
+    uint32_t reserved[2];
+  };
+
+#define MP_PROC 0               /* Processor entry type. */
+#define MP_PROC_ENABLED 0x01    /* Processor is usable. */
+#define MP_PROC_BSP 0x02        /* Processor is the BSP. */
+
+/* Local APIC registers, as offsets in 32-bit words. */
+#define LAPIC_ID (0x020 / 4)    /* Local APIC ID. */
+#define LAPIC_TPR (0x080 / 4)   /* Task priority. */
+#define LAPIC_EOI (0x0b0 / 4)   /* End of interrupt. */
+#define LAPIC_SVR (0x0f0 / 4)   /* Spurious interrupt vector. */
+#define LAPIC_ICRLO (0x300 / 4) /* Interrupt command, low word. */
+#define LAPIC_ICRHI (0x310 / 4) /* Interrupt command, high word. */
+#define LAPIC_TIMER (0x320 / 4) /* Timer local vector table entry. */
+#define LAPIC_TICR (0x380 / 4)  /* Timer initial count. */
+#define LAPIC_TCCR (0x390 / 4)  /* Timer current count. */
+#define LAPIC_TDCR (0x3e0 / 4)  /* Timer divide configuration. */
+
+#define SVR_ENABLE 0x100        /* Local APIC software enable. */
+#define ICR_INIT 0x500          /* INIT delivery mode. */
+#define ICR_STARTUP 0x600       /* Start-up (SIPI) delivery mode. */
+#define ICR_PENDING 0x1000      /* Delivery status: send pending. */
+#define ICR_ASSERT 0x4000       /* Level: assert. */
+#define ICR_LEVEL 0x8000        /* Trigger mode: level. */
+#define LVT_MASKED 0x10000      /* Local vector table entry masked. */
+#define LVT_PERIODIC 0x20000    /* Timer mode: periodic. */
+#define TDCR_DIV16 0x3          /* Timer counts at bus clock / 16. */
+
+/* Default physical address of the local APIC. */
+#define LAPIC_DEFAULT_ADDR 0xfee00000
+
+/* Kernel virtual address at which the local APIC is mapped, in
+   the last page of the address space. */
+#define LAPIC_VADDR ((void *) 0xfffff000)
+
+/* Local APIC registers, or a null pointer if there is no local
+   APIC. */
+static volatile uint32_t *lapic;
+
+/* Physical address that application processors start executing
+   at, in real mode.  Must be page-aligned and below 1 MB, in
+   memory not otherwise in use once the kernel is running. */
+#define AP_TRAMPOLINE 0x8000
+
+/* AP startup code in ap-start.S, copied to AP_TRAMPOLINE. */
+extern char ap_trampoline[], ap_trampoline_end[];
+extern char ap_trampoline_gdtdesc[], ap_trampoline_cr3[];
+
+/* Passed to the starting AP.  Used by ap-start.S. */
+void *ap_stack;
+static struct cpu *volatile ap_cpu;
+
+/* Set once the bootstrap processor has started every AP, to let
+   them go on. */
+static volatile bool aps_go;
+
+#ifndef USERPROG
+/* Local APIC timer count for one timer tick. */
+static uint32_t lapic_tick_count;
+#endif
+
+void cpu_ap_main (void) NO_RETURN;
+
+static struct mp_float *mp_search (void);
+static struct mp_float *mp_search_range (uintptr_t start, size_t size);
+static bool mp_checksum (const void *, size_t size);
+static void lapic_map (uintptr_t paddr);
+static void lapic_ipi (uint8_t apic_id, uint32_t command);
+static bool start_ap (struct cpu *);
+#ifndef USERPROG
+static void lapic_timer_calibrate (void);
+static void lapic_init_ap (void);
+static intr_handler_func lapic_timer_interrupt;
+static intr_handler_func resched_interrupt;
+#endif
+
+/* Finds the CPUs in the MP configuration table and maps the
+   local APIC.  Must be called after paging_init().  Leaves
+   cpu_cnt at 1 if there is no MP table. */
+void
+cpu_init (void)
+{
+  struct mp_float *mpf;
+  struct mp_config *conf;
+  uint8_t *p;
+  int i;
+
+  cpus[0].id = 0;
+  cpus[0].started = true;
+  cpus[0].online = true;
+
+  mpf = mp_search ();
+  if (mpf == NULL || mpf->config == 0 || mpf->type != 0)
+    return;
+  conf = ptov (mpf->config);
+  if (memcmp (conf->signature, "PCMP", 4)
+      || !mp_checksum (conf, conf->length))
+    return;
+
+  lapic_map (conf->lapic_addr != 0 ? conf->lapic_addr : LAPIC_DEFAULT_ADDR);
+  cpus[0].apic_id = lapic[LAPIC_ID] >> 24;
+
+  p = (uint8_t *) (conf + 1);
+  for (i = 0; i < conf->entry_cnt; i++)
+    if (*p == MP_PROC)
+      {
+        struct mp_proc *proc = (struct mp_proc *) p;
+        if ((proc->flags & MP_PROC_ENABLED)
+            && proc->apic_id != cpus[0].apic_id)
+          {
+            if (cpu_cnt < CPU_MAX)
+              {
+                struct cpu *c = &cpus[cpu_cnt];
+                c->id = cpu_cnt++;
+                c->apic_id = proc->apic_id;
+              }
+            else
+              printf ("Ignoring CPU with APIC ID %d: too many CPUs.\n",
+                      proc->apic_id);
+          }
+        p += sizeof *proc;
+      }
+    else
+      p += 8;
+}
+
+/* Returns the CPU that the running thread is on. */
+struct cpu *
+cpu_current (void)
+{
+  return thread_current ()->cpu;
+}
+
+/* Makes CPU C reconsider which thread to run, because a thread
+   has just been put in its run queue from another CPU.  Does
+   nothing if C is offline.  Interrupts must be off. */
+void
+cpu_kick (struct cpu *c)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c->online)
+    lapic_ipi (c->apic_id, ICR_ASSERT | CPU_RESCHED_VEC);
+}
+
+/* Acknowledges the interrupt from the running CPU's local APIC
+   that is being handled. */
+void
+cpu_lapic_eoi (void)
+{
+  lapic[LAPIC_EOI] = 0;
+}
+
+/* Starts the application processors found by cpu_init() and
+   puts them online, each running its own idle thread, so that
+   new threads start going to them.  With USERPROG, parks them
+   instead, since only the bootstrap processor has a TSS.
+
+   Must be called with interrupts on, after thread_start().  Uses
+   timer_udelay(), so the timer must have been calibrated. */
+void
+cpu_start_aps (void)
+{
+  uint32_t *pd = init_page_dir;
+  uint8_t *trampoline = ptov (AP_TRAMPOLINE);
+  uint32_t *cr3;
+  void *gdtdesc;
+  int started = 0;
+  int i;
+
+  if (cpu_cnt == 1 || !cpu_smp)
+    return;
+
+  /* Copy the startup code into place and give it our GDT and
+     page directory. */
+  memcpy (trampoline, ap_trampoline, ap_trampoline_end - ap_trampoline);
+  gdtdesc = trampoline + (ap_trampoline_gdtdesc - ap_trampoline);
+  cr3 = (uint32_t *) (trampoline + (ap_trampoline_cr3 - ap_trampoline));
+  asm volatile ("sgdt (%0)" : : "r" (gdtdesc) : "memory");
+  *cr3 = vtop (init_page_dir);
+
+  /* The APs turn on paging while still running at
+     AP_TRAMPOLINE, so identity map the first 4 MB of physical
+     memory while they start. */
+  pd[0] = pd[pd_no (PHYS_BASE)];
+
+  lapic[LAPIC_SVR] = SVR_ENABLE | CPU_SPURIOUS_VEC;
+#ifndef USERPROG
+  lapic_timer_calibrate ();
+  intr_register_ext (CPU_TIMER_VEC, lapic_timer_interrupt, "LAPIC Timer");
+  intr_register_ext (CPU_RESCHED_VEC, resched_interrupt, "Reschedule");
+#endif
+  for (i = 1; i < cpu_cnt; i++)
+    if (start_ap (&cpus[i]))
+      started++;
+    else
+      printf ("CPU %d (APIC ID %d) did not start.\n",
+              i, cpus[i].apic_id);
+
+  pd[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+#ifdef USERPROG
+  aps_go = true;
+  printf ("Parked %d of %d application processors.\n",
+          started, cpu_cnt - 1);
+#else
+  /* Let the APs go, and wait for them to come online. */
+  intr_start_smp ();
+  aps_go = true;
+  for (i = 1; i < cpu_cnt; i++)
+    while (cpus[i].started && !cpus[i].online)
+      barrier ();
+
+  printf ("%d of %d application processors online.\n",
+          started, cpu_cnt - 1);
+#endif
+}
+
+/* Starts CPU C with the INIT-SIPI-SIPI sequence and waits for it
+   to report in.  Returns true if it did. */
+static bool
+start_ap (struct cpu *c)
+{
+  int i;
+
+  ap_stack = (uint8_t *) palloc_get_page (PAL_ASSERT) + PGSIZE;
+  ap_cpu = c;
+
+  lapic_ipi (c->apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  lapic_ipi (c->apic_id, ICR_INIT | ICR_LEVEL);
+  timer_mdelay (10);
+  for (i = 0; i < 2; i++)
+    {
+      lapic_ipi (c->apic_id, ICR_STARTUP | (AP_TRAMPOLINE >> 12));
+      timer_udelay (200);
+    }
+
+  for (i = 0; i < 100 && !c->started; i++)
+    timer_mdelay (1);
+  if (c->started)
+    return true;
+
+  /* Put the CPU back into its wait-for-SIPI state, in case it is
+     just slow, so that it cannot start later on a stack that has
+     been freed. */
+  lapic_ipi (c->apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  lapic_ipi (c->apic_id, ICR_INIT | ICR_LEVEL);
+  palloc_free_page ((uint8_t *) ap_stack - PGSIZE);
+  return false;
+}
+
+/* Entry point for an application processor, called by ap-start.S
+   on the stack in ap_stack, with interrupts off.  Reports in,
+   waits for the bootstrap processor to start the rest, and then
+   becomes the CPU's idle thread. */
+void
+cpu_ap_main (void)
+{
+  struct cpu *c = ap_cpu;
+
+  intr_load_idt ();
+  fpu_init_cpu ();
+  c->started = true;
+  while (!aps_go)
+    asm volatile ("pause");
+
+#ifdef USERPROG
+  for (;;)
+    asm volatile ("cli; hlt");
+#else
+  /* Drop the TLB entries for the identity mapping that the
+     bootstrap processor has removed. */
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  lapic_init_ap ();
+  intr_start_ap ();
+  thread_start_ap (c);
+#endif
+}
+
+/* Sends interrupt COMMAND to the local APIC with APIC_ID and
+   waits for it to be delivered. */
+static void
+lapic_ipi (uint8_t apic_id, uint32_t command)
+{
+  lapic[LAPIC_ICRHI] = (uint32_t) apic_id << 24;
+  lapic[LAPIC_ICRLO] = command;
+  while (lapic[LAPIC_ICRLO] & ICR_PENDING)
+    asm volatile ("pause");
+}
+
+#ifndef USERPROG
+/* Sets lapic_tick_count by counting down the local APIC timer for
+   one timer tick.  All local APIC timers run at the bus clock, so
+   the count is good for every CPU. */
+static void
+lapic_timer_calibrate (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  lapic[LAPIC_TDCR] = TDCR_DIV16;
+  lapic[LAPIC_TIMER] = LVT_MASKED | CPU_TIMER_VEC;
+  lapic[LAPIC_TICR] = UINT32_MAX;
+  timer_udelay (1000 * 1000 / TIMER_FREQ);
+  lapic_tick_count = UINT32_MAX - lapic[LAPIC_TCCR];
+  lapic[LAPIC_TICR] = 0;
+
+  intr_set_level (old_level);
+}
+
+/* Sets up the running AP's local APIC to accept interrupts and to
+   interrupt TIMER_FREQ times per second. */
+static void
+lapic_init_ap (void)
+{
+  lapic[LAPIC_SVR] = SVR_ENABLE | CPU_SPURIOUS_VEC;
+  lapic[LAPIC_TPR] = 0;
+  lapic[LAPIC_TDCR] = TDCR_DIV16;
+  lapic[LAPIC_TIMER] = LVT_PERIODIC | CPU_TIMER_VEC;
+  lapic[LAPIC_TICR] = lapic_tick_count;
+}
+
+/* Local APIC timer interrupt handler, on an AP. */
+static void
+lapic_timer_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_ap_tick ();
+}
+
+/* Reschedule interrupt handler, for cpu_kick(). */
+static void
+resched_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_preempt_if_needed ();
+}
+#endif /* !USERPROG */
+
+/* Maps the local APIC registers at physical address PADDR into
+   the kernel page directory at LAPIC_VADDR, uncached. */
+static void
+lapic_map (uintptr_t paddr)
+{
+  uint32_t *pd = init_page_dir;
+  uint32_t *pt;
+
+  ASSERT (pg_ofs ((void *) paddr) == 0);
+
+  pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  pd[pd_no (LAPIC_VADDR)] = pde_create (pt);
+  pt[pt_no (LAPIC_VADDR)] = paddr | PTE_P | PTE_W | PTE_PWT | PTE_PCD;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  lapic = LAPIC_VADDR;
+}
+
+/* Searches for the MP floating pointer structure in the places
+   listed in [MP] 4: the first kB of the extended BIOS data area,
+   the last kB of base memory, and the BIOS ROM. */
+static struct mp_float *
+mp_search (void)
+{
+  uint16_t ebda = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_float *mpf;
+
+  if (ebda != 0 && (mpf = mp_search_range ((uintptr_t) ebda << 4, 1024)))
+    return mpf;
+  if ((mpf = mp_search_range (base_kb * 1024 - 1024, 1024)) != NULL)
+    return mpf;
+  return mp_search_range (0xf0000, 0x10000);
+}
+
+/* Searches SIZE bytes of physical memory starting at START for
+   the MP floating pointer structure. */
+static struct mp_float *
+mp_search_range (uintptr_t start, size_t size)
+{
+  uint8_t *p = ptov (start);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_float) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && mp_checksum (p, sizeof (struct mp_float)))
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0. */
+static bool
+mp_checksum (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
@@ -0,0 +1,106 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <heap.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* CPUs.
+
+   The kernel keeps a struct cpu for each processor listed in the
+   MP configuration table, and each has its own run queue and
+   spinlock.  A new thread goes to the least loaded CPU.  A CPU
+   whose run queue is empty steals the next thread of the busiest
+   other CPU, which is the only way that threads move.
+
+   The rest of the kernel still turns interrupts off for mutual
+   exclusion, so a CPU holds the interrupt lock in interrupt.c
+   whenever its interrupts are off, and only one CPU at a time
+   runs such code.  Threads on different CPUs run in parallel the
+   rest of the time.  The 8259 PIC still sends every device
+   interrupt to the bootstrap processor, which keeps the global
+   timer.  Each application processor gets time slices from its
+   own local APIC timer and a reschedule interrupt when a thread
+   is queued on it from another CPU.  Neither the I/O APIC nor
+   the ACPI tables are used.
+
+   User programs would need a TSS for each CPU, so with USERPROG
+   the application processors are only started far enough to
+   prove that they can run kernel code, and then parked with
+   interrupts off. */
+
+/* Maximum number of CPUs supported. */
+#define CPU_MAX 8
+
+/* Local APIC interrupt vectors, between INTR_LAPIC_FIRST and
+   INTR_LAPIC_LAST. */
+#define CPU_TIMER_VEC 0x40      /* Local APIC timer. */
+#define CPU_RESCHED_VEC 0x41    /* Reschedule, from cpu_kick(). */
+#define CPU_SPURIOUS_VEC 0x4f   /* Local APIC spurious interrupt. */
+
+/* Number of thread priority levels. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* Per-CPU area. */
+struct cpu
+  {
+    /* Owned by cpu.c. */
+    int id;                     /* Index in cpus[]. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    volatile bool started;      /* Set by the CPU once it is running. */
+    bool online;                /* Takes part in thread scheduling? */
+
+    /* Run queue, owned by thread.c.  There is one FIFO list per
+       priority level, and bit P of ready_bitmap is set exactly
+       when ready_lists[P] is nonempty, so that the
+       highest-priority ready thread can be found without
+       scanning.  The stride scheduler uses stride_heap instead,
+       a min-heap on pass value.  Periodic real-time threads are
+       kept apart in rt_heap, a min-heap on deadline, and run
+       before all others. */
+    struct spinlock rq_lock;            /* Protects the run queue. */
+    struct list ready_lists[PRI_CNT];   /* Threads in THREAD_READY state. */
+    uint64_t ready_bitmap;              /* Nonempty ready_lists[]. */
+    struct heap stride_heap;            /* Same, under the stride scheduler. */
+    int64_t stride_vtime;               /* Pass value of last thread picked. */
+    struct heap rt_heap;                /* Ready periodic threads. */
+    int ready_cnt;                      /* # of threads in the run queue. */
+    struct thread *idle_thread;         /* Runs when the queue is empty. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    bool preempting;                    /* Running thread being preempted? */
+    unsigned local_ticks;               /* # of local APIC timer ticks. */
+
+    /* Pages of dead threads kept for new ones, owned by thread.c.
+       The pages are linked through their first word. */
+    void *thread_pages;                 /* First free page, or null. */
+    int thread_page_cnt;                /* # of pages in the list. */
+
+    /* Thread whose state is in the FPU registers, owned by
+       fpu.c. */
+    struct thread *fpu_owner;           /* Null if none. */
+
+    /* Statistics, owned by thread.c. */
+    uint64_t account_start;             /* Cycle count at last accounting. */
+    uint64_t idle_cycles;               /* # of cycles spent idle. */
+    unsigned steals;                    /* # of threads taken from others. */
+  };
+
+/* All the CPUs found at boot.  The bootstrap processor, which
+   runs init.c:main(), is always cpus[0]. */
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+/* If false, do not start the application processors at all.
+   Controlled by kernel command-line option "-nosmp". */
+extern bool cpu_smp;
+
+void cpu_init (void);
+void cpu_start_aps (void);
+struct cpu *cpu_current (void);
+void cpu_kick (struct cpu *);
+void cpu_lapic_eoi (void);
+
+#endif /* threads/cpu.h */
@@ -0,0 +1,217 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* CR0 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR0_MP 0x00000002       /* Monitor coProcessor. */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task Switched. */
+#define CR0_NE 0x00000020       /* Numeric Error. */
+
+/* CR4 bits. */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE, FXRSTOR, and SSE enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* Unmasked SSE exceptions enabled. */
+
+/* CPUID.1:EDX feature bits. */
+#define CPUID_FXSR 0x01000000   /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE 0x02000000    /* SSE. */
+
+/* Default MXCSR: all SSE exceptions masked. */
+#define MXCSR_DEFAULT 0x1f80
+
+/* A thread's saved FPU and SSE state.  FXSAVE needs a 512-byte
+   area aligned on a 16-byte boundary, which malloc() does not
+   promise, so the area is found within a larger buffer. */
+struct fpu_state
+  {
+    bool valid;                 /* False until first saved. */
+    uint8_t buffer[512 + 15];   /* FXSAVE area, somewhere inside. */
+  };
+
+/* True if the CPU has FXSAVE and SSE, so that user programs may
+   use the FPU.  Otherwise CR0.EM stays set and any FPU
+   instruction kills the process. */
+static bool fpu_present;
+
+/* Number of times the FPU changed hands. */
+static unsigned fpu_switches;
+
+static intr_handler_func fpu_trap;
+
+/* Returns the FXSAVE area in S. */
+static inline void *
+fxsave_area (struct fpu_state *s)
+{
+  return (void *) ROUND_UP ((uintptr_t) s->buffer, 16);
+}
+
+/* Loads CR0. */
+static inline uint32_t
+read_cr0 (void)
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+/* Sets CR0.TS, so that the next FPU instruction raises #NM. */
+static inline void
+stts (void)
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (read_cr0 () | CR0_TS));
+}
+
+/* Clears CR0.TS. */
+static inline void
+clts (void)
+{
+  asm volatile ("clts");
+}
+
+/* Checks for FPU support and, if it is there, registers the #NM
+   handler.  Must be called after intr_init() and before
+   exception_init(). */
+void
+fpu_init (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  fpu_present = (edx & (CPUID_FXSR | CPUID_SSE)) == (CPUID_FXSR | CPUID_SSE);
+  if (!fpu_present)
+    {
+      printf ("FPU: no FXSAVE or SSE support, FPU disabled\n");
+      return;
+    }
+
+  intr_register_int (7, 0, INTR_ON, fpu_trap,
+                     "#NM Device Not Available Exception");
+  fpu_init_cpu ();
+}
+
+/* Returns true if user programs may use the FPU, false if FPU
+   instructions fault. */
+bool
+fpu_available (void)
+{
+  return fpu_present;
+}
+
+/* Turns on the FPU and SSE for the running CPU, which start.S
+   and ap-start.S leave emulated, with TS set so that the first
+   thread to use them traps. */
+void
+fpu_init_cpu (void)
+{
+  uint32_t cr4;
+
+  if (!fpu_present)
+    return;
+
+  asm volatile ("movl %0, %%cr0"
+                : : "r" ((read_cr0 () & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS));
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+}
+
+/* Called by thread_schedule_tail() as thread T starts running.
+   Lets T use the FPU without a trap if its state is already in
+   the registers, and otherwise arms the trap.  Interrupts must
+   be off. */
+void
+fpu_activate (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!fpu_present)
+    return;
+  if (t->cpu->fpu_owner == t)
+    clts ();
+  else
+    stts ();
+}
+
+/* Called by thread_exit() to release the running thread's FPU
+   state. */
+void
+fpu_exit (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (cur->cpu->fpu_owner == cur)
+    {
+      cur->cpu->fpu_owner = NULL;
+      stts ();
+    }
+  intr_set_level (old_level);
+
+  free (cur->fpu);
+  cur->fpu = NULL;
+}
+
+/* #NM handler, for the running thread's first FPU instruction
+   since it was switched in.  Saves the state of the CPU's FPU
+   owner, if any, and loads the running thread's. */
+static void
+fpu_trap (struct intr_frame *f UNUSED)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  struct cpu *c;
+
+  if (cur->fpu == NULL)
+    {
+      cur->fpu = malloc (sizeof *cur->fpu);
+      if (cur->fpu == NULL)
+        {
+          printf ("%s: out of memory for FPU state\n", cur->name);
+          thread_exit ();
+        }
+      cur->fpu->valid = false;
+    }
+
+  /* We may have been switched out above, so look at the owner
+     only with interrupts off. */
+  old_level = intr_disable ();
+  c = cur->cpu;
+  clts ();
+  if (c->fpu_owner != cur)
+    {
+      struct thread *owner = c->fpu_owner;
+
+      if (owner != NULL)
+        {
+          asm volatile ("fxsave %0"
+                        : "=m" (*(uint8_t (*)[512]) fxsave_area (owner->fpu)));
+          owner->fpu->valid = true;
+        }
+      if (cur->fpu->valid)
+        asm volatile ("fxrstor %0"
+                      : : "m" (*(uint8_t (*)[512]) fxsave_area (cur->fpu)));
+      else
+        {
+          uint32_t mxcsr = MXCSR_DEFAULT;
+          asm volatile ("fninit; ldmxcsr %0" : : "m" (mxcsr));
+        }
+      c->fpu_owner = cur;
+      fpu_switches++;
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void)
+{
+  if (fpu_switches > 0)
+    printf ("FPU: %u state switches\n", fpu_switches);
+}
@@ -0,0 +1,26 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+/* Lazy FPU and SSE context switching.
+
+   The kernel itself never uses the FPU, but user programs may.
+   A CPU's FPU registers hold the state of the last thread that
+   used them, the CPU's FPU owner, until another thread needs
+   them.  Every context switch to a thread other than the owner
+   sets CR0.TS, so that the thread's first FPU or SSE instruction
+   raises #NM, and only then is the owner's state saved and the
+   new thread's restored.  Threads that never touch the FPU never
+   pay for it. */
+
+struct thread;
+
+void fpu_init (void);
+bool fpu_available (void);
+void fpu_init_cpu (void);
+void fpu_activate (struct thread *);
+void fpu_exit (void);
+void fpu_print_stats (void);
+
+#endif /* threads/fpu.h */
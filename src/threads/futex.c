@@ -0,0 +1,143 @@
+#include "threads/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <syscall-nr.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in a bucket. */
+    int *addr;                  /* The futex. */
+    struct thread *thread;      /* The sleeping thread. */
+    struct timer_elem timer;    /* Timeout, if any. */
+    bool woken;                 /* Woken by futex_wake()? */
+    bool timed_out;             /* Woken by the timeout? */
+  };
+
+/* Sleeping threads, hashed on the futex's address.  Threads waiting
+   on different futexes can share a bucket.  Protected by
+   disabling interrupts, since timeouts remove waiters from the
+   timer interrupt. */
+#define FUTEX_BUCKETS 64
+static struct list buckets[FUTEX_BUCKETS];
+
+static timer_func futex_timeout;
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    list_init (&buckets[i]);
+}
+
+/* Returns the bucket for the futex at ADDR. */
+static struct list *
+futex_bucket (const int *addr)
+{
+  return &buckets[hash_int ((uintptr_t) addr / sizeof *addr) % FUTEX_BUCKETS];
+}
+
+/* If the futex at kernel address ADDR, which must be aligned,
+   still holds EXPECTED, sleeps until futex_wake() wakes us or
+   TIMEOUT_MS milliseconds pass, or indefinitely if TIMEOUT_MS is
+   negative.  Returns 0 if woken, FUTEX_AGAIN if the futex did not
+   hold EXPECTED, or FUTEX_TIMEDOUT if the timeout passed.
+
+   Comparing the value and going to sleep are atomic with respect
+   to futex_wake(), so that a wakeup that comes after the futex is
+   changed cannot be missed. */
+int
+futex_wait (int *addr, int expected, int timeout_ms)
+{
+  struct futex_waiter w;
+  enum intr_level old_level;
+
+  ASSERT ((uintptr_t) addr % sizeof *addr == 0);
+
+  old_level = intr_disable ();
+  if (*(volatile int *) addr != expected)
+    {
+      intr_set_level (old_level);
+      return FUTEX_AGAIN;
+    }
+  if (timeout_ms == 0)
+    {
+      intr_set_level (old_level);
+      return FUTEX_TIMEDOUT;
+    }
+
+  w.addr = addr;
+  w.thread = thread_current ();
+  w.woken = w.timed_out = false;
+  list_push_back (futex_bucket (addr), &w.elem);
+  if (timeout_ms > 0)
+    timer_add (&w.timer,
+               timer_ticks () + DIV_ROUND_UP ((int64_t) timeout_ms
+                                              * TIMER_FREQ, 1000),
+               futex_timeout, &w);
+  thread_block ();
+  if (timeout_ms > 0)
+    timer_cancel (&w.timer);
+  intr_set_level (old_level);
+
+  return w.timed_out ? FUTEX_TIMEDOUT : 0;
+}
+
+/* Wakes up to CNT threads sleeping on the futex at kernel address
+   ADDR, oldest first.  Returns the number woken. */
+int
+futex_wake (int *addr, int cnt)
+{
+  enum intr_level old_level;
+  struct list *bucket;
+  struct list_elem *e;
+  int woken = 0;
+
+  ASSERT ((uintptr_t) addr % sizeof *addr == 0);
+
+  bucket = futex_bucket (addr);
+  old_level = intr_disable ();
+  for (e = list_begin (bucket); e != list_end (bucket) && woken < cnt; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      e = list_next (e);
+      if (w->addr == addr)
+        {
+          list_remove (&w->elem);
+          w->woken = true;
+          thread_unblock (w->thread);
+          woken++;
+        }
+    }
+  intr_set_level (old_level);
+
+  thread_preempt_if_needed ();
+  return woken;
+}
+
+/* Timer callback for a futex_wait() timeout. */
+static void
+futex_timeout (void *w_)
+{
+  struct futex_waiter *w = w_;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* A wakeup may have beaten us to it. */
+  if (w->woken)
+    return;
+  list_remove (&w->elem);
+  w->timed_out = true;
+  thread_unblock (w->thread);
+  thread_preempt_if_needed ();
+}
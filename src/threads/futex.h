@@ -0,0 +1,20 @@
+#ifndef THREADS_FUTEX_H
+#define THREADS_FUTEX_H
+
+/* Fast user-space mutexes.
+
+   A futex is an int in memory.  User programs synchronize by
+   updating futexes with atomic instructions, and enter the kernel
+   only to sleep until a futex changes or to wake the threads
+   sleeping on one.
+
+   The wait queues are keyed on the futex's kernel virtual
+   address.  The system call handler translates a user address to
+   the kernel alias of its physical page, so processes that share
+   memory share futexes. */
+
+void futex_init (void);
+int futex_wait (int *addr, int expected, int timeout_ms);
+int futex_wake (int *addr, int cnt);
+
+#endif /* threads/futex.h */
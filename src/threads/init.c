@@ -15,13 +15,19 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/futex.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -62,6 +68,8 @@ static void paging_init (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
+static int parse_int_option (const char *name, const char *value,
+                             int min, int max);
 static void run_actions (char **argv);
 static void usage (void);
 
@@ -96,8 +104,11 @@ main (void)
 
   /* Initialize memory system. */
   palloc_init (user_page_limit);
+  trace_init ();
   malloc_init ();
+  slab_init ();
   paging_init ();
+  cpu_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -107,6 +118,7 @@ main (void)
 
   /* Initialize interrupt handlers. */
   intr_init ();
+  fpu_init ();
   timer_init ();
   kbd_init ();
   input_init ();
@@ -117,8 +129,11 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_init ();
+  futex_init ();
   serial_init_queue ();
   timer_calibrate ();
+  cpu_start_aps ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -256,6 +271,33 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-stride"))
+        thread_stride = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-donate-depth"))
+        thread_donation_depth = parse_int_option (name, value,
+                                                  1, DONATION_DEPTH_MAX);
+      else if (!strcmp (name, "-thread-cache"))
+        thread_cache_max = parse_int_option (name, value,
+                                             0, THREAD_CACHE_MAX);
+      else if (!strcmp (name, "-decay-batch"))
+        {
+          thread_decay_batch = atoi (value);
+          if (thread_decay_batch < 1)
+            PANIC ("-decay-batch must be at least 1");
+        }
+      else if (!strcmp (name, "-trace"))
+        {
+          if (!trace_configure (value))
+            PANIC ("unknown trace class in `%s'", value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-nosmp"))
+        cpu_smp = false;
+      else if (!strcmp (name, "-nomag"))
+        malloc_magazines = false;
+      else if (!strcmp (name, "-intr-timing"))
+        intr_timing = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -277,6 +319,29 @@ parse_options (char **argv)
   return argv;
 }
 
+/* Returns VALUE, the value given for option NAME, as an integer.
+   Panics unless VALUE is a decimal integer between MIN and MAX,
+   inclusive, so that a typo cannot silently turn into 0 or a
+   negative count. */
+static int
+parse_int_option (const char *name, const char *value, int min, int max)
+{
+  const char *p = value;
+  int n = 0;
+
+  if (p == NULL || *p == '\0')
+    PANIC ("%s needs a value from %d to %d", name, min, max);
+  for (; *p != '\0'; p++)
+    {
+      if (*p < '0' || *p > '9' || n > (INT_MAX - 9) / 10)
+        PANIC ("%s=%s: value must be from %d to %d", name, value, min, max);
+      n = n * 10 + (*p - '0');
+    }
+  if (n < min || n > max)
+    PANIC ("%s=%s: value must be from %d to %d", name, value, min, max);
+  return n;
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv)
@@ -292,6 +357,23 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Has thread_print_stats() print a table of every thread's CPU
+   accounting at shutdown.  Threads that exit before this action
+   runs are left out of the table. */
+static void
+thread_stats_action (char **argv UNUSED)
+{
+  thread_stats_table = true;
+}
+
+/* Writes the scheduler trace recorded so far to the serial
+   port. */
+static void
+trace_dump_action (char **argv UNUSED)
+{
+  trace_dump ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,6 +391,8 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"thread-stats", 1, thread_stats_action},
+      {"trace-dump", 1, trace_dump_action},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -357,6 +441,8 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  thread-stats       Print per-thread CPU accounting at shutdown.\n"
+          "  trace-dump         Write the scheduler trace to the serial port.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -379,6 +465,15 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -stride            Use stride (proportional-share) scheduler.\n"
+          "  -donate-depth=N    Propagate priority donation through N locks.\n"
+          "  -thread-cache=N    Keep up to N free thread pages per CPU.\n"
+          "  -decay-batch=N     Decay N ready threads per MLFQS run queue lock.\n"
+          "  -tickless          Stop the timer tick while idle.\n"
+          "  -nosmp             Do not start application processors.\n"
+          "  -nomag             Bypass malloc's per-CPU magazines.\n"
+          "  -intr-timing       Record how long interrupts stay off.\n"
+          "  -trace=sched       Record scheduler events for utils/pintos-trace.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
@@ -38,15 +39,49 @@ static const char *intr_names[INTR_CNT];
 static unsigned int unexpected_cnt[INTR_CNT];
 
 /* External interrupts are those generated by devices outside the
-   CPU, such as the timer.  External interrupts run with
-   interrupts turned off, so they never nest, nor are they ever
-   pre-empted.  Handlers for external interrupts also may not
-   sleep, although they may invoke intr_yield_on_return() to
-   request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
+   CPU, such as the timer, and by each CPU's local APIC.  External
+   interrupts run with interrupts turned off, so they never nest,
+   nor are they ever pre-empted.  Handlers for external interrupts
+   also may not sleep, although they may invoke
+   intr_yield_on_return() to request that a new process be
+   scheduled just before the interrupt returns.  A CPU in an
+   external interrupt holds the interrupt lock (see below), so
+   only one CPU at a time can be in one. */
+static struct cpu *intr_cpu;    /* CPU processing an external interrupt. */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Interrupt lock.  The kernel turns interrupts off for mutual
+   exclusion, which only excludes the other threads on the same
+   CPU.  Once the application processors run threads,
+   intr_start_smp() makes every CPU also hold this lock whenever
+   its interrupts are off: intr_disable() acquires it,
+   intr_enable() releases it, and an interrupt that arrives with
+   interrupts on does both around its handler.  Threads switch
+   with interrupts off, so the lock belongs to the CPU, not to a
+   thread, and the next thread to run is the one that releases
+   it. */
+static volatile int intr_lock;
+static bool intr_lock_used;
+
+/* If true, time external interrupt handlers and the periods
+   with interrupts off, which costs a time-stamp counter read on
+   every transition.  Controlled by kernel command-line option
+   "-intr-timing". */
+bool intr_timing;
+
+/* Longest external interrupt handler, in time-stamp counter
+   cycles. */
+static uint64_t max_external_cycles;
+
+/* Time-stamp counter when interrupts were last turned off, and
+   the longest time they have stayed off, in cycles.  Interrupts
+   go off in intr_disable() and on entry to an interrupt handler,
+   and back on in intr_enable() and on return from the handler.
+   The time may span a thread switch, since the next thread is
+   the one that turns them back on. */
+static uint64_t off_start;
+static uint64_t max_off_cycles;
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -56,6 +91,14 @@ static uint64_t make_intr_gate (void (*) (void), int dpl);
 static uint64_t make_trap_gate (void (*) (void), int dpl);
 static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 
+/* Interrupt lock. */
+static void intr_lock_acquire (void);
+static void intr_lock_release (void);
+
+/* Interrupts-off timing. */
+static void intr_off_begin (void);
+static void intr_off_end (void);
+
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 static void unexpected_interrupt (const struct intr_frame *);
@@ -90,6 +133,13 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (old_level == INTR_OFF)
+    {
+      if (intr_timing)
+        intr_off_end ();
+      intr_lock_release ();
+    }
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -110,14 +160,100 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    {
+      intr_lock_acquire ();
+      if (intr_timing)
+        intr_off_begin ();
+    }
   return old_level;
 }
+
+/* Enables interrupts and waits for the next one, which must be
+   off.  Returns after the interrupt has been handled, with
+   interrupts on. */
+void
+intr_wait (void)
+{
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (intr_timing)
+    intr_off_end ();
+  intr_lock_release ();
+
+  /* The `sti' instruction disables interrupts until the
+     completion of the next instruction, so these two
+     instructions are executed atomically.  This atomicity is
+     important; otherwise, an interrupt could be handled between
+     re-enabling interrupts and waiting for the next one to occur,
+     wasting as much as one clock tick worth of time.
+
+     See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
+     7.11.1 "HLT Instruction". */
+  asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* Makes every CPU hold the interrupt lock while its interrupts
+   are off.  Called once on the bootstrap processor, with
+   interrupts on, before any other CPU may touch kernel data. */
+void
+intr_start_smp (void)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+  intr_lock_used = true;
+}
+
+/* Called on an application processor, with interrupts off, just
+   before it starts to run threads.  Acquires the interrupt lock,
+   which the AP then holds whenever its interrupts are off, like
+   every other CPU. */
+void
+intr_start_ap (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (intr_lock_used);
+  intr_lock_acquire ();
+}
+
+/* Acquires the interrupt lock for the running CPU, whose
+   interrupts must be off.  Does nothing until intr_start_smp()
+   has been called. */
+static void
+intr_lock_acquire (void)
+{
+  int old;
+
+  if (!intr_lock_used)
+    return;
+
+  do
+    {
+      while (intr_lock != 0)
+        asm volatile ("pause");
+      old = 1;
+      asm volatile ("xchgl %0, %1" : "+r" (old), "+m" (intr_lock)
+                    : : "memory");
+    }
+  while (old != 0);
+}
+
+/* Releases the interrupt lock held by the running CPU, whose
+   interrupts must still be off. */
+static void
+intr_lock_release (void)
+{
+  if (!intr_lock_used)
+    return;
+
+  asm volatile ("" : : : "memory");
+  intr_lock = 0;
+}
 
 /* Initializes the interrupt system. */
 void
 intr_init (void)
 {
-  uint64_t idtr_operand;
   int i;
 
   /* Initialize interrupt controller. */
@@ -127,11 +263,7 @@ intr_init (void)
   for (i = 0; i < INTR_CNT; i++)
     idt[i] = make_intr_gate (intr_stubs[i], 0);
 
-  /* Load IDT register.
-     See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
-     Descriptor Table (IDT)". */
-  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
-  asm volatile ("lidt %0" : : "m" (idtr_operand));
+  intr_load_idt ();
 
   /* Initialize intr_names. */
   for (i = 0; i < INTR_CNT; i++)
@@ -157,6 +289,17 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Loads the IDT register of the running CPU.  Called by
+   intr_init() and by each application processor as it starts.
+   See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
+   Descriptor Table (IDT)". */
+void
+intr_load_idt (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -181,7 +324,8 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT ((vec_no >= 0x20 && vec_no <= 0x2f)
+          || (vec_no >= INTR_LAPIC_FIRST && vec_no <= INTR_LAPIC_LAST));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -203,6 +347,7 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
   ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (vec_no < INTR_LAPIC_FIRST || vec_no > INTR_LAPIC_LAST);
   register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -211,7 +356,58 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return intr_cpu != NULL && intr_cpu == cpu_current ();
+}
+
+/* Returns the longest time, in nanoseconds, that an external
+   interrupt handler has run with interrupts off since boot or
+   the last call to intr_reset_max_external().  Always 0 unless
+   intr_timing is true. */
+int64_t
+intr_max_external_ns (void)
+{
+  return timer_cycles_to_ns (max_external_cycles);
+}
+
+/* Resets the longest external interrupt handler time. */
+void
+intr_reset_max_external (void)
+{
+  max_external_cycles = 0;
+}
+
+/* Returns the longest time, in nanoseconds, that interrupts have
+   stayed off since boot or the last call to intr_reset_max_off(),
+   whether turned off by intr_disable() or by an interrupt.
+   Always 0 unless intr_timing is true. */
+int64_t
+intr_max_off_ns (void)
+{
+  return timer_cycles_to_ns (max_off_cycles);
+}
+
+/* Resets the longest time with interrupts off. */
+void
+intr_reset_max_off (void)
+{
+  max_off_cycles = 0;
+}
+
+/* Notes that interrupts have just been turned off. */
+static void
+intr_off_begin (void)
+{
+  off_start = timer_cycles ();
+}
+
+/* Notes that interrupts are about to be turned back on. */
+static void
+intr_off_end (void)
+{
+  uint64_t cycles = timer_cycles () - off_start;
+
+  if (cycles > max_off_cycles)
+    max_off_cycles = cycles;
 }
 
 /* During processing of an external interrupt, directs the
@@ -345,27 +541,43 @@ void
 intr_handler (struct intr_frame *frame) 
 {
   bool external;
+  bool was_on = (frame->eflags & FLAG_IF) != 0;
   intr_handler_func *handler;
+  uint64_t start = 0;
+
+  /* An interrupt gate turns interrupts off on the way in. */
+  if (was_on && intr_get_level () == INTR_OFF)
+    {
+      intr_lock_acquire ();
+      if (intr_timing)
+        intr_off_begin ();
+    }
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or the local
+     APIC (see below).  An external interrupt handler cannot
+     sleep. */
+  external = ((frame->vec_no >= 0x20 && frame->vec_no < 0x30)
+              || (frame->vec_no >= INTR_LAPIC_FIRST
+                  && frame->vec_no <= INTR_LAPIC_LAST));
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
+      intr_cpu = cpu_current ();
       yield_on_return = false;
+      if (intr_timing)
+        start = timer_cycles ();
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == CPU_SPURIOUS_VEC)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -380,11 +592,29 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      intr_cpu = NULL;
+      if (frame->vec_no < INTR_LAPIC_FIRST)
+        pic_end_of_interrupt (frame->vec_no); 
+      else if (frame->vec_no != CPU_SPURIOUS_VEC)
+        cpu_lapic_eoi ();
+
+      if (intr_timing)
+        {
+          uint64_t cycles = timer_cycles () - start;
+          if (cycles > max_external_cycles)
+            max_external_cycles = cycles;
+        }
 
       if (yield_on_return) 
-        thread_yield (); 
+        thread_preempt (); 
+    }
+
+  /* Returning restores the interrupted code's interrupt flag. */
+  if (was_on && intr_get_level () == INTR_OFF)
+    {
+      if (intr_timing)
+        intr_off_end ();
+      intr_lock_release ();
     }
 }
 
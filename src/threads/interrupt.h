@@ -15,6 +15,13 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+void intr_wait (void);
+void intr_start_smp (void);
+void intr_start_ap (void);
+
+/* If true, time interrupt handlers and interrupts-off periods.
+   Controlled by kernel command-line option "-intr-timing". */
+extern bool intr_timing;
 
 /* Interrupt stack frame. */
 struct intr_frame
@@ -57,12 +64,24 @@ struct intr_frame
 
 typedef void intr_handler_func (struct intr_frame *);
 
+/* Vectors for the interrupts that each CPU's local APIC raises
+   by itself.  They are external interrupts like those from the
+   PICs at 0x20...0x2f, but are acknowledged on the local APIC.
+   See threads/cpu.c. */
+#define INTR_LAPIC_FIRST 0x40
+#define INTR_LAPIC_LAST 0x4f
+
 void intr_init (void);
+void intr_load_idt (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
+int64_t intr_max_external_ns (void);
+void intr_reset_max_external (void);
+int64_t intr_max_off_ns (void);
+void intr_reset_max_off (void);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
@@ -1,46 +1,109 @@
 #include "threads/malloc.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <list.h>
 #include <round.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   Small requests, up to SMALL_MAX bytes, are rounded up to one of
+   a set of size classes and assigned to the "descriptor" that
+   manages blocks of that size.  Between 64 bytes and SMALL_MAX,
+   there are four classes per power of 2 (64, 80, 96, 112, 128,
+   160, ...), so that no request wastes more than a fifth of its
+   block.  The descriptor keeps a list of free blocks.  If the
+   free list is nonempty, one of its blocks is used to satisfy the
+   request.
+
+   Otherwise, a new "arena" of one or more pages is obtained from
+   the page allocator (if none is available, malloc() returns a
+   null pointer).  Each descriptor uses the number of pages per
+   arena, 1, 2, or 4, that leaves the least space unused at the
+   end.  The new arena is divided into blocks, all of which are
+   added to the descriptor's free list.  Then we return one of the
+   new blocks.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Each CPU also keeps a "magazine" for each descriptor, a small
+   stack of free blocks that malloc() and free() use first.  They
+   need only turn off interrupts for a moment, not take the
+   descriptor's lock, which may sleep.  An empty magazine is
+   refilled with half its capacity from the descriptor, and a full
+   one drains half of its blocks back, so that the lock is taken
+   once per batch of blocks instead of once per block.  Blocks in
+   a magazine count as in use, as far as their arena is concerned.
+   The magazines can be bypassed, for comparison, by setting
+   malloc_magazines to false with the -nomag option.
+
+   Medium requests, up to MEDIUM_MAX bytes, are carved out of
+   shared arenas of MEDIUM_ARENA_PAGES pages.  Each piece, or
+   "chunk", starts with a header that gives its size and the size
+   of the chunk before it, so that a freed chunk can be merged
+   with free neighbors on both sides.  Free chunks are kept on
+   lists segregated by size, and a request takes the first chunk
+   big enough from the lowest list that can hold one, splitting
+   off what it does not need.
+
+   We handle requests bigger than that by allocating contiguous
+   pages with the page allocator and sticking the allocation size
+   at the beginning of the allocated block's arena header.
+
+   An arena may span several pages, so a block cannot find its
+   arena just by rounding its address down.  Instead, each page
+   of the kernel pool that holds an arena's blocks maps back to
+   the arena through the page_arenas table. */
+
+/* Largest request served by a descriptor. */
+#define SMALL_MAX 1792
+
+/* Largest request served from medium arenas. */
+#define MEDIUM_MAX (16 * 1024)
+
+/* Number of pages in a medium arena. */
+#define MEDIUM_ARENA_PAGES 8
+
+/* Statistics on one kind of allocation. */
+struct alloc_stats
+  {
+    unsigned cnt;               /* Number of allocations. */
+    uint64_t requested;         /* Total bytes requested. */
+    uint64_t allocated;         /* Total bytes set aside. */
+  };
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
+    size_t arena_pages;         /* Number of pages in an arena. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t mag_size;            /* Capacity of magazines. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    size_t lock_cnt;            /* Number of times LOCK was taken. */
+  };
+
+/* Most blocks that a magazine can hold. */
+#define MAG_MAX 16
+
+/* Magazine: free blocks kept by a CPU for one descriptor. */
+struct magazine
+  {
+    size_t cnt;                 /* Number of blocks. */
+    struct block *blocks[MAG_MAX]; /* Blocks, used as a stack. */
+    struct alloc_stats stats;   /* This CPU's allocations. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -50,8 +113,9 @@ struct desc
 struct arena 
   {
     unsigned magic;             /* Always set to ARENA_MAGIC. */
-    struct desc *desc;          /* Owning descriptor, null for big block. */
-    size_t free_cnt;            /* Free blocks; pages in big block. */
+    struct desc *desc;          /* Owning descriptor, null otherwise. */
+    size_t free_cnt;            /* Free blocks; pages otherwise. */
+    bool medium;                /* Medium arena? */
   };
 
 /* Free block. */
@@ -60,28 +124,154 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Chunk of a medium arena. */
+struct chunk
+  {
+    size_t size;                /* Size including header, | CHUNK_USED. */
+    size_t prev_size;           /* Size of previous chunk, 0 if first. */
+  };
+
+/* Set in a chunk's size if it is in use. */
+#define CHUNK_USED 1
+
+/* Chunk sizes are multiples of this. */
+#define CHUNK_ALIGN 16
+
+/* Free chunk. */
+struct free_chunk
+  {
+    struct chunk chunk;         /* Header. */
+    struct list_elem free_elem; /* Element in a medium_bins[] list. */
+  };
+
+/* Offset of the first chunk in a medium arena. */
+#define CHUNK_OFS ROUND_UP (sizeof (struct arena), CHUNK_ALIGN)
+
+/* Number of free chunk lists.  List I holds free chunks of I kB
+   up to but not including I + 1 kB, except the last, which holds
+   all the bigger ones. */
+#define MEDIUM_BINS (MEDIUM_MAX / 1024 + 1)
+
+/* If false, malloc() and free() bypass the magazines and take
+   the descriptor's lock for every block.  Controlled by kernel
+   command-line option "-nomag". */
+bool malloc_magazines = true;
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[24];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Maps a small request size, divided by 16 and rounded up, to
+   the index of the descriptor to use. */
+static uint8_t size_to_desc[SMALL_MAX / 16 + 1];
+
+/* Each CPU's magazines, indexed by CPU and descriptor.  Protected
+   by turning off interrupts. */
+static struct magazine mags[CPU_MAX][sizeof descs / sizeof *descs];
+
+/* Medium arenas. */
+static struct lock medium_lock;         /* Protects the following. */
+static struct list medium_bins[MEDIUM_BINS]; /* Free chunks by size. */
+static struct alloc_stats medium_stats; /* Medium allocations. */
+
+/* Big blocks.  Protected by turning off interrupts. */
+static struct alloc_stats big_stats;
+
+/* Maps the physical page number of each page that holds blocks
+   to the arena that the page belongs to. */
+static struct arena **page_arenas;
+
+static size_t get_blocks (struct desc *, struct block **, size_t);
+static void put_blocks (struct desc *, struct block **, size_t);
+static void *medium_alloc (size_t);
+static void medium_free (struct arena *, void *);
+static void set_arena (struct arena *, size_t page_cnt, struct arena *);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
+/* Returns the number of pages, 1, 2, or 4, to use for arenas of
+   BLOCK_SIZE-byte blocks: the fewest that leave no more than a
+   sixteenth of the arena unused, or failing that, the one that
+   wastes the smallest fraction. */
+static size_t
+pick_arena_pages (size_t block_size)
+{
+  size_t best = 1, best_waste = PGSIZE;
+  size_t pages;
+
+  for (pages = 1; pages <= 4; pages *= 2)
+    {
+      size_t waste = (PGSIZE * pages - sizeof (struct arena)) % block_size;
+      if (waste * 16 <= PGSIZE * pages)
+        return pages;
+      if (waste * best < best_waste * pages)
+        {
+          best = pages;
+          best_waste = waste;
+        }
+    }
+  return best;
+}
+
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
-  size_t block_size;
+  size_t block_size, step, i, size;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  for (block_size = 16; block_size <= SMALL_MAX; block_size += step)
     {
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->arena_pages = pick_arena_pages (block_size);
+      d->blocks_per_arena = ((PGSIZE * d->arena_pages - sizeof (struct arena))
+                             / block_size);
+      d->mag_size = 2 * d->blocks_per_arena;
+      if (d->mag_size > MAG_MAX)
+        d->mag_size = MAG_MAX;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      d->lock_cnt = 0;
+
+      /* Quarter steps between powers of 2 from 64 up. */
+      if (block_size < 64)
+        step = 16;
+      else
+        {
+          size_t pow;
+          for (pow = 64; pow * 2 <= block_size; pow *= 2)
+            continue;
+          step = pow / 4;
+        }
+    }
+
+  i = 0;
+  for (size = 0; size <= SMALL_MAX / 16; size++)
+    {
+      while (descs[i].block_size < size * 16)
+        i++;
+      size_to_desc[size] = i;
     }
+
+  lock_init (&medium_lock);
+  for (i = 0; i < MEDIUM_BINS; i++)
+    list_init (&medium_bins[i]);
+
+  page_arenas = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                     DIV_ROUND_UP (init_ram_pages
+                                                   * sizeof *page_arenas,
+                                                   PGSIZE));
+}
+
+/* Adds ALLOCATED bytes set aside for a REQUESTED-byte request to
+   statistics S. */
+static inline void
+count_alloc (struct alloc_stats *s, size_t requested, size_t allocated)
+{
+  s->cnt++;
+  s->requested += requested;
+  s->allocated += allocated;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -90,21 +280,20 @@ void *
 malloc (size_t size) 
 {
   struct desc *d;
+  struct magazine *m;
+  struct block *batch[MAG_MAX / 2];
   struct block *b;
   struct arena *a;
+  enum intr_level old_level;
+  size_t batch_cnt;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
     return NULL;
 
-  /* Find the smallest descriptor that satisfies a SIZE-byte
-     request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  if (size > MEDIUM_MAX) 
     {
-      /* SIZE is too big for any descriptor.
+      /* SIZE is too big for any descriptor or medium arena.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
@@ -116,40 +305,47 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
-      return a + 1;
-    }
+      a->medium = false;
+      set_arena (a, 1, a);
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
-    {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      old_level = intr_disable ();
+      count_alloc (&big_stats, size, page_cnt * PGSIZE);
+      intr_set_level (old_level);
+      return a + 1;
     }
+  else if (size > SMALL_MAX)
+    return medium_alloc (size);
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  d = &descs[size_to_desc[DIV_ROUND_UP (size, 16)]];
+
+  /* Fast path: take a block from this CPU's magazine. */
+  old_level = intr_disable ();
+  m = &mags[cpu_current ()->id][d - descs];
+  count_alloc (&m->stats, size, d->block_size);
+  b = malloc_magazines && m->cnt > 0 ? m->blocks[--m->cnt] : NULL;
+  intr_set_level (old_level);
+  if (b != NULL)
+    return b;
+  if (!malloc_magazines)
+    return get_blocks (d, &b, 1) > 0 ? b : NULL;
+
+  /* Refill the magazine from the descriptor, keeping one block
+     for ourselves.  We might have moved to another CPU, or
+     another thread might have refilled the magazine, while we
+     held the lock, so give back whatever does not fit. */
+  batch_cnt = get_blocks (d, batch, d->mag_size / 2);
+  if (batch_cnt == 0)
+    return NULL;
+  b = batch[--batch_cnt];
+  old_level = intr_disable ();
+  m = &mags[cpu_current ()->id][d - descs];
+  while (batch_cnt > 0 && m->cnt < d->mag_size)
+    m->blocks[m->cnt++] = batch[--batch_cnt];
+  intr_set_level (old_level);
+  if (batch_cnt > 0)
+    put_blocks (d, batch, batch_cnt);
   return b;
 }
 
@@ -182,7 +378,28 @@ block_size (void *block)
   struct arena *a = block_to_arena (b);
   struct desc *d = a->desc;
 
-  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+  if (d != NULL)
+    return d->block_size;
+  else if (a->medium)
+    return (((struct chunk *) block - 1)->size & ~CHUNK_USED)
+           - sizeof (struct chunk);
+  else
+    return PGSIZE * a->free_cnt - pg_ofs (block);
+}
+
+/* Returns the number of bytes that malloc() sets aside for a
+   SIZE-byte request, not counting arena headers. */
+size_t
+malloc_round_size (size_t size)
+{
+  if (size <= SMALL_MAX)
+    return descs[size_to_desc[DIV_ROUND_UP (size, 16)]].block_size;
+  else if (size <= MEDIUM_MAX)
+    return (ROUND_UP (size + sizeof (struct chunk), CHUNK_ALIGN)
+            - sizeof (struct chunk));
+  else
+    return (ROUND_UP (size + sizeof (struct arena), PGSIZE)
+            - sizeof (struct arena));
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -227,56 +444,367 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct magazine *m;
+          struct block *batch[MAG_MAX / 2 + 1];
+          enum intr_level old_level;
+          size_t batch_cnt = 0;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
+          if (!malloc_magazines)
+            {
+              put_blocks (d, &b, 1);
+              return;
+            }
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put the block in this CPU's magazine.  If the
+             magazine is full, take half of its blocks out, along
+             with this one, to give back to the descriptor. */
+          old_level = intr_disable ();
+          m = &mags[cpu_current ()->id][d - descs];
+          if (m->cnt >= d->mag_size)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              while (batch_cnt < d->mag_size / 2)
+                batch[batch_cnt++] = m->blocks[--m->cnt];
+              batch[batch_cnt++] = b;
             }
+          else
+            m->blocks[m->cnt++] = b;
+          intr_set_level (old_level);
 
-          lock_release (&d->lock);
+          if (batch_cnt > 0)
+            put_blocks (d, batch, batch_cnt);
         }
+      else if (a->medium)
+        medium_free (a, p);
       else
         {
           /* It's a big block.  Free its pages. */
+          set_arena (a, 1, NULL);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Takes up to CNT blocks from descriptor D's free list, creating
+   new arenas as needed, and stores them in BLOCKS.  Returns the
+   number of blocks obtained, which is less than CNT only if
+   memory ran out. */
+static size_t
+get_blocks (struct desc *d, struct block **blocks, size_t cnt)
+{
+  size_t got;
+
+  lock_acquire (&d->lock);
+  d->lock_cnt++;
+  for (got = 0; got < cnt; got++)
+    {
+      struct block *b;
+      struct arena *a;
+
+      /* If the free list is empty, create a new arena. */
+      if (list_empty (&d->free_list))
+        {
+          size_t i;
+
+          /* Allocate pages. */
+          a = palloc_get_multiple (0, d->arena_pages);
+          if (a == NULL)
+            break;
+
+          /* Initialize arena and add its blocks to the free list. */
+          a->magic = ARENA_MAGIC;
+          a->desc = d;
+          a->free_cnt = d->blocks_per_arena;
+          a->medium = false;
+          set_arena (a, d->arena_pages, a);
+          for (i = 0; i < d->blocks_per_arena; i++)
+            {
+              b = arena_to_block (a, i);
+              list_push_back (&d->free_list, &b->free_elem);
+            }
+        }
+
+      /* Get a block from free list. */
+      b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+      a = block_to_arena (b);
+      a->free_cnt--;
+      blocks[got] = b;
+    }
+  lock_release (&d->lock);
+  return got;
+}
+
+/* Returns the CNT blocks in BLOCKS to descriptor D's free list,
+   freeing any arena that no longer has a block in use. */
+static void
+put_blocks (struct desc *d, struct block **blocks, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&d->lock);
+  d->lock_cnt++;
+  for (i = 0; i < cnt; i++)
+    {
+      struct block *b = blocks[i];
+      struct arena *a = block_to_arena (b);
+
+      /* Add block to free list. */
+      list_push_front (&d->free_list, &b->free_elem);
+
+      /* If the arena is now entirely unused, free it. */
+      if (++a->free_cnt >= d->blocks_per_arena)
+        {
+          size_t j;
+
+          ASSERT (a->free_cnt == d->blocks_per_arena);
+          for (j = 0; j < d->blocks_per_arena; j++)
+            {
+              struct block *b = arena_to_block (a, j);
+              list_remove (&b->free_elem);
+            }
+          set_arena (a, d->arena_pages, NULL);
+          palloc_free_multiple (a, d->arena_pages);
+        }
+    }
+  lock_release (&d->lock);
+}
+
+/* Obtains and returns a chunk of at least SIZE bytes from a
+   medium arena.  Returns a null pointer if memory is not
+   available. */
+static void *
+medium_alloc (size_t size)
+{
+  size_t need = ROUND_UP (size + sizeof (struct chunk), CHUNK_ALIGN);
+  struct free_chunk *f = NULL;
+  struct chunk *c;
+  size_t bin;
+
+  lock_acquire (&medium_lock);
+
+  /* Find the first chunk big enough, starting from the bin that
+     NEED falls in. */
+  for (bin = need / 1024; bin < MEDIUM_BINS && f == NULL; bin++)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&medium_bins[bin]); e != list_end (&medium_bins[bin]);
+           e = list_next (e))
+        {
+          struct free_chunk *candidate = list_entry (e, struct free_chunk,
+                                                     free_elem);
+          if (candidate->chunk.size >= need)
+            {
+              f = candidate;
+              break;
+            }
+        }
+    }
+
+  if (f == NULL)
+    {
+      /* Start a new arena, all one free chunk. */
+      struct arena *a = palloc_get_multiple (0, MEDIUM_ARENA_PAGES);
+      if (a == NULL)
+        {
+          lock_release (&medium_lock);
+          return NULL;
+        }
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      a->free_cnt = MEDIUM_ARENA_PAGES;
+      a->medium = true;
+      set_arena (a, MEDIUM_ARENA_PAGES, a);
+
+      f = (struct free_chunk *) ((uint8_t *) a + CHUNK_OFS);
+      f->chunk.size = PGSIZE * MEDIUM_ARENA_PAGES - CHUNK_OFS;
+      f->chunk.prev_size = 0;
+    }
+  else
+    list_remove (&f->free_elem);
+
+  /* Split off the part we don't need, if it is big enough to be
+     a chunk. */
+  c = &f->chunk;
+  if (c->size - need >= sizeof (struct free_chunk))
+    {
+      struct arena *a = block_to_arena ((struct block *) c);
+      uint8_t *end = (uint8_t *) a + PGSIZE * a->free_cnt;
+      struct chunk *rest = (struct chunk *) ((uint8_t *) c + need);
+      struct chunk *next;
+
+      rest->size = c->size - need;
+      rest->prev_size = need;
+      next = (struct chunk *) ((uint8_t *) rest + rest->size);
+      if ((uint8_t *) next < end)
+        next->prev_size = rest->size;
+      c->size = need;
+
+      f = (struct free_chunk *) rest;
+      bin = rest->size / 1024 < MEDIUM_BINS ? rest->size / 1024 : MEDIUM_BINS - 1;
+      list_push_front (&medium_bins[bin], &f->free_elem);
+    }
+  count_alloc (&medium_stats, size, c->size);
+  c->size |= CHUNK_USED;
+
+  lock_release (&medium_lock);
+  return c + 1;
+}
+
+/* Frees medium chunk P, in arena A, merging it with its free
+   neighbors.  Frees A if that leaves it entirely unused. */
+static void
+medium_free (struct arena *a, void *p)
+{
+  struct chunk *c = (struct chunk *) p - 1;
+  uint8_t *first = (uint8_t *) a + CHUNK_OFS;
+  uint8_t *end = (uint8_t *) a + PGSIZE * a->free_cnt;
+  struct chunk *next;
+  size_t bin;
+
+  ASSERT (c->size & CHUNK_USED);
+
+#ifndef NDEBUG
+  /* Clear the chunk to help detect use-after-free bugs. */
+  memset (p, 0xcc, (c->size & ~CHUNK_USED) - sizeof *c);
+#endif
+
+  lock_acquire (&medium_lock);
+  c->size &= ~CHUNK_USED;
+
+  /* Merge with the next chunk. */
+  next = (struct chunk *) ((uint8_t *) c + c->size);
+  if ((uint8_t *) next < end && !(next->size & CHUNK_USED))
+    {
+      list_remove (&((struct free_chunk *) next)->free_elem);
+      c->size += next->size;
+    }
+
+  /* Merge with the previous chunk. */
+  if (c->prev_size != 0)
+    {
+      struct chunk *prev = (struct chunk *) ((uint8_t *) c - c->prev_size);
+      if (!(prev->size & CHUNK_USED))
+        {
+          list_remove (&((struct free_chunk *) prev)->free_elem);
+          prev->size += c->size;
+          c = prev;
+        }
+    }
+
+  next = (struct chunk *) ((uint8_t *) c + c->size);
+  if ((uint8_t *) next < end)
+    next->prev_size = c->size;
+
+  if ((uint8_t *) c == first && (uint8_t *) next == end)
+    {
+      /* The arena is entirely unused, so free it. */
+      set_arena (a, MEDIUM_ARENA_PAGES, NULL);
+      palloc_free_multiple (a, MEDIUM_ARENA_PAGES);
+    }
+  else
+    {
+      bin = c->size / 1024 < MEDIUM_BINS ? c->size / 1024 : MEDIUM_BINS - 1;
+      list_push_front (&medium_bins[bin], &((struct free_chunk *) c)->free_elem);
+    }
+  lock_release (&medium_lock);
+}
+
+/* Prints one line of statistics S, for allocations of kind
+   NAME. */
+static void
+print_alloc_stats (const char *name, const struct alloc_stats *s)
+{
+  if (s->cnt == 0)
+    return;
+  printf ("Malloc: %s: %u allocations, %"PRIu64" of %"PRIu64" bytes "
+          "used (%"PRIu64"%% internal fragmentation)\n",
+          name, s->cnt, s->requested, s->allocated,
+          (s->allocated - s->requested) * 100 / s->allocated);
+}
+
+/* Prints statistics on how much of the memory set aside for
+   each size class, for medium chunks, and for big blocks went
+   unused because it was rounded up from the request. */
+void
+malloc_print_stats (void)
+{
+  struct alloc_stats total = { 0, 0, 0 };
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct alloc_stats s = { 0, 0, 0 };
+      char name[16];
+      int cpu;
+
+      for (cpu = 0; cpu < CPU_MAX; cpu++)
+        {
+          const struct alloc_stats *m = &mags[cpu][i].stats;
+          s.cnt += m->cnt;
+          s.requested += m->requested;
+          s.allocated += m->allocated;
+        }
+      snprintf (name, sizeof name, "%zu-byte", descs[i].block_size);
+      print_alloc_stats (name, &s);
+      total.cnt += s.cnt;
+      total.requested += s.requested;
+      total.allocated += s.allocated;
+    }
+  print_alloc_stats ("medium", &medium_stats);
+  print_alloc_stats ("big", &big_stats);
+
+  total.cnt += medium_stats.cnt + big_stats.cnt;
+  total.requested += medium_stats.requested + big_stats.requested;
+  total.allocated += medium_stats.allocated + big_stats.allocated;
+  print_alloc_stats ("total", &total);
+}
+
+/* Returns the number of times that malloc() and free() have
+   taken a descriptor's lock, for measuring how well the
+   magazines work. */
+size_t
+malloc_lock_cnt (void)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    cnt += descs[i].lock_cnt;
+  return cnt;
+}
+
+/* Makes the PAGE_CNT pages starting at PAGES map to arena A, or
+   to no arena if A is null. */
+static void
+set_arena (struct arena *pages, size_t page_cnt, struct arena *a)
+{
+  size_t page_no = vtop (pages) >> PGBITS;
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_arenas[page_no + i] = a;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
 {
-  struct arena *a = pg_round_down (b);
+  struct arena *a = page_arenas[vtop (b) >> PGBITS];
 
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
   ASSERT (a->magic == ARENA_MAGIC);
 
   /* Check that the block is properly aligned for the arena. */
-  ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
-  ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
+  ASSERT (a->desc == NULL || a->medium
+          || ((uint8_t *) b - (uint8_t *) (a + 1)) % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || a->medium || b == (struct block *) (a + 1));
 
   return a;
 }
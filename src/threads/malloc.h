@@ -2,12 +2,20 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+/* If false, bypass the per-CPU magazines.
+   Controlled by kernel command-line option "-nomag". */
+extern bool malloc_magazines;
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+size_t malloc_round_size (size_t);
+void malloc_print_stats (void);
+size_t malloc_lock_cnt (void);
 
 #endif /* threads/malloc.h */
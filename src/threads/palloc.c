@@ -1,7 +1,7 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -10,6 +10,7 @@
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -23,22 +24,81 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed by a binary buddy allocator.  Free memory
+   is kept as blocks of 2**ORDER pages, for ORDER from 0 up to
+   ORDER_CNT - 1, each aligned on a multiple of its size relative
+   to the pool's base, on one free list per order.  A block's
+   "buddy" is the other half of the block of the next order up.
+   An allocation takes the smallest free block big enough,
+   splitting larger blocks as needed, and returns the pages past
+   the request to the free lists.  Freeing merges each block with
+   its buddy for as long as the buddy is free too.  Both take
+   O(log n) time in the size of the pool.
+
+   A free block's list element is kept in its first page.  The
+   pool's `orders' array records, for the first page of each free
+   block, that it is free and its order.
+
+   Each pool also keeps a small stock of pages that are free and
+   already filled with zeros, outside the buddy lists.  The idle
+   thread tops it up, so that zeroing happens only when the CPU
+   would otherwise be idle, and a PAL_ZERO request for a single
+   page takes one from the stock if it can.  Pages in the stock
+   cannot merge with their buddies, so a request that the buddy
+   lists cannot satisfy returns the whole stock to them before
+   giving up. */
+
+/* Number of block orders.  The largest block is 2**(ORDER_CNT -
+   1) pages. */
+#define ORDER_CNT 16
+
+/* Marks an entry in a pool's `orders' as the start of a free
+   block.  The low bits give the block's order. */
+#define ORDER_FREE 0x80
+
+/* Most pages to keep zeroed in each pool. */
+#define ZEROED_MAX 32
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Protects the fields below. */
+    uint8_t *orders;                    /* Per page: ORDER_FREE|order or 0. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+    size_t free_cnt[ORDER_CNT];         /* # of blocks in each list. */
+    void *zeroed[ZEROED_MAX];           /* Free pages filled with zeros. */
+    size_t zeroed_cnt;                  /* # of pages in zeroed[]. */
+
+    size_t page_cnt;                    /* # of pages in pool. */
     uint8_t *base;                      /* Base of pool. */
   };
 
-/* Two pools: one for kernel data, one for user pages. */
+/* Two pools: one for kernel data, one for user pages.  Each is
+   protected by a spinlock rather than a lock, since
+   thread_schedule_tail() frees pages with interrupts off and must
+   not sleep. */
 static struct pool kernel_pool, user_pool;
 
+/* Background zeroing statistics. */
+static struct spinlock zero_lock;       /* Protects the variables below. */
+static unsigned zero_hits;              /* PAL_ZERO requests from stock. */
+static unsigned zero_misses;            /* PAL_ZERO requests zeroed at once. */
+static uint64_t zero_miss_cycles;       /* Cycles zeroing for misses. */
+static unsigned zero_bg_pages;          /* Pages zeroed while idle. */
+static uint64_t zero_bg_cycles;         /* Cycles spent zeroing while idle. */
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t get_block (struct pool *, int order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, int order);
+static bool flush_zeroed (struct pool *);
+static void zero_pages (void *, size_t page_cnt);
+static bool zero_wanted (struct pool *);
+static void zero_one (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -55,6 +115,8 @@ palloc_init (size_t user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
 
+  spinlock_init (&zero_lock);
+
   /* Give half of memory to kernel, half to user. */
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
@@ -71,25 +133,41 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  void *pages = NULL;
   size_t page_idx;
+  int order;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* Round up to a block order. */
+  for (order = 0; order < ORDER_CNT && (size_t) 1 << order < page_cnt;
+       order++)
+    continue;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  if (order < ORDER_CNT)
+    {
+      /* If no block is big enough, return the stock of zeroed
+         pages to the free lists, where they may merge into one
+         that is, and try again. */
+      spinlock_acquire (&pool->lock);
+      do
+        page_idx = get_block (pool, order);
+      while (page_idx == SIZE_MAX && flush_zeroed (pool));
+      if (page_idx != SIZE_MAX)
+        {
+          /* Give back the part of the block we don't need. */
+          free_range (pool, page_idx + page_cnt,
+                      ((size_t) 1 << order) - page_cnt);
+          pages = pool->base + PGSIZE * page_idx;
+        }
+      spinlock_release (&pool->lock);
+    }
 
   if (pages != NULL) 
     {
       if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+        zero_pages (pages, page_cnt);
     }
   else 
     {
@@ -110,7 +188,38 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  void *page = NULL;
+
+  spinlock_acquire (&pool->lock);
+  if ((flags & PAL_ZERO) && pool->zeroed_cnt > 0)
+    {
+      /* Take a page that is already zeroed.  The idle thread
+         will replace it. */
+      page = pool->zeroed[--pool->zeroed_cnt];
+      spinlock_release (&pool->lock);
+
+      spinlock_acquire (&zero_lock);
+      zero_hits++;
+      spinlock_release (&zero_lock);
+      return page;
+    }
+
+  /* Fast path: take a free single page, if there is one, without
+     splitting anything. */
+  if (!list_empty (&pool->free_lists[0]))
+    {
+      page = list_pop_front (&pool->free_lists[0]);
+      pool->free_cnt[0]--;
+      pool->orders[pg_no (page) - pg_no (pool->base)] = 0;
+    }
+  spinlock_release (&pool->lock);
+
+  if (page == NULL)
+    return palloc_get_multiple (flags, 1);
+  if (flags & PAL_ZERO)
+    zero_pages (page, 1);
+  return page;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -132,13 +241,15 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  spinlock_acquire (&pool->lock);
+  free_range (pool, page_idx, page_cnt);
+  spinlock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +259,110 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns true if either pool's stock of zeroed pages is short
+   and it has a free page to fill it with.  Called by the
+   idle thread, with interrupts off, before it halts the CPU. */
+bool
+palloc_zero_wanted (void)
+{
+  return zero_wanted (&kernel_pool) || zero_wanted (&user_pool);
+}
+
+/* Zeroes a page for each pool whose stock of zeroed pages is
+   short.  Called by the idle thread, with interrupts on. */
+void
+palloc_zero_idle (void)
+{
+  zero_one (&kernel_pool);
+  zero_one (&user_pool);
+}
+
+/* Prints the free blocks of each order in POOL, named NAME. */
+static void
+print_pool_stats (struct pool *pool, const char *name)
+{
+  size_t free_cnt[ORDER_CNT];
+  size_t free_pages;
+  int order, top;
+
+  /* Copy the counts, so as not to print with the lock held. */
+  spinlock_acquire (&pool->lock);
+  memcpy (free_cnt, pool->free_cnt, sizeof free_cnt);
+  free_pages = pool->zeroed_cnt;
+  spinlock_release (&pool->lock);
+
+  for (order = 0; order < ORDER_CNT; order++)
+    free_pages += free_cnt[order] << order;
+  for (top = ORDER_CNT - 1; top > 0 && free_cnt[top] == 0; top--)
+    continue;
+
+  printf ("Palloc: %s: %zu of %zu pages free, blocks by order:",
+          name, free_pages, pool->page_cnt);
+  for (order = 0; order <= top; order++)
+    printf (" %zu", free_cnt[order]);
+  printf ("\n");
+}
+
+/* Prints page allocator statistics: how fragmented the free
+   memory in each pool is. */
+void
+palloc_print_stats (void)
+{
+  unsigned hits, misses, bg_pages;
+  uint64_t miss_cycles, bg_cycles;
+  uint64_t saved_ns = 0;
+
+  print_pool_stats (&kernel_pool, "kernel pool");
+  print_pool_stats (&user_pool, "user pool");
+
+  spinlock_acquire (&zero_lock);
+  hits = zero_hits;
+  misses = zero_misses;
+  miss_cycles = zero_miss_cycles;
+  bg_pages = zero_bg_pages;
+  bg_cycles = zero_bg_cycles;
+  spinlock_release (&zero_lock);
+
+  /* Estimate the zeroing that hits saved from the mean time per
+     page zeroed while idle. */
+  if (bg_pages > 0)
+    saved_ns = timer_cycles_to_ns (bg_cycles / bg_pages) * hits;
+  printf ("Palloc: zeroed pages: %u hits, %u misses, "
+          "%"PRId64" us zeroing on allocation, "
+          "%"PRId64" us saved by zeroing in background\n",
+          hits, misses, timer_cycles_to_ns (miss_cycles) / 1000,
+          (int64_t) saved_ns / 1000);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's orders array at its base.
+     Calculate the space needed for it
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t map_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (map_pages > page_cnt)
+    PANIC ("Not enough memory in %s for page map.", name);
+  page_cnt -= map_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, with all of its pages free. */
+  spinlock_init (&p->lock);
+  p->orders = base;
+  memset (p->orders, 0, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  p->page_cnt = page_cnt;
+  p->base = base + map_pages * PGSIZE;
+  free_range (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +372,175 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the first page of free block PAGE_IDX in POOL. */
+static inline struct list_elem *
+block_elem (struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Removes a free block of 2**ORDER pages from POOL, splitting a
+   larger one if necessary, and returns the index of its first
+   page.  Returns SIZE_MAX if there is none.  POOL's lock must
+   be held. */
+static size_t
+get_block (struct pool *pool, int order)
+{
+  struct list_elem *e;
+  size_t page_idx;
+  int have;
+
+  for (have = order; have < ORDER_CNT; have++)
+    if (!list_empty (&pool->free_lists[have]))
+      break;
+  if (have >= ORDER_CNT)
+    return SIZE_MAX;
+
+  e = list_pop_front (&pool->free_lists[have]);
+  pool->free_cnt[have]--;
+  page_idx = pg_no (e) - pg_no (pool->base);
+  pool->orders[page_idx] = 0;
+
+  /* Split, putting the upper half back each time. */
+  while (have > order)
+    {
+      size_t upper;
+
+      have--;
+      upper = page_idx + ((size_t) 1 << have);
+      pool->orders[upper] = ORDER_FREE | have;
+      list_push_front (&pool->free_lists[have], block_elem (pool, upper));
+      pool->free_cnt[have]++;
+    }
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks that cover them.  POOL's lock must be
+   held. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      int order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 1 << (order + 1)) == 0
+             && page_idx + ((size_t) 1 << (order + 1)) <= end)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+    }
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL,
+   merging it with its buddy for as long as the buddy is free.
+   POOL's lock must be held. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->orders[page_idx] == 0);
+
+  for (; order + 1 < ORDER_CNT; order++)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->orders[buddy] != (ORDER_FREE | order))
+        break;
+
+      list_remove (block_elem (pool, buddy));
+      pool->free_cnt[order]--;
+      pool->orders[buddy] = 0;
+      if (buddy < page_idx)
+        page_idx = buddy;
+    }
+
+  pool->orders[page_idx] = ORDER_FREE | order;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+  pool->free_cnt[order]++;
+}
+
+/* Returns the zeroed pages in POOL's stock to its free lists.
+   Returns false if there were none.  POOL's lock must be held. */
+static bool
+flush_zeroed (struct pool *pool)
+{
+  if (pool->zeroed_cnt == 0)
+    return false;
+  while (pool->zeroed_cnt > 0)
+    free_range (pool, pg_no (pool->zeroed[--pool->zeroed_cnt])
+                      - pg_no (pool->base), 1);
+  return true;
+}
+
+/* Fills the PAGE_CNT pages at PAGES with zeros, on behalf of a
+   PAL_ZERO request that found no zeroed page in stock. */
+static void
+zero_pages (void *pages, size_t page_cnt)
+{
+  uint64_t start = timer_cycles ();
+
+  memset (pages, 0, PGSIZE * page_cnt);
+
+  spinlock_acquire (&zero_lock);
+  zero_misses++;
+  zero_miss_cycles += timer_cycles () - start;
+  spinlock_release (&zero_lock);
+}
+
+/* Returns true if POOL's stock of zeroed pages is short and
+   POOL has a free page to fill it with.  Reads without POOL's
+   lock, so the answer is only a hint. */
+static bool
+zero_wanted (struct pool *pool)
+{
+  int order;
+
+  if (pool->zeroed_cnt >= ZEROED_MAX)
+    return false;
+  for (order = 0; order < ORDER_CNT; order++)
+    if (pool->free_cnt[order] > 0)
+      return true;
+  return false;
+}
+
+/* Takes a single free page from POOL's free lists and zeroes it
+   for POOL's stock, if the stock is short. */
+static void
+zero_one (struct pool *pool)
+{
+  size_t page_idx;
+  uint64_t start;
+  void *page;
+
+  spinlock_acquire (&pool->lock);
+  page_idx = pool->zeroed_cnt < ZEROED_MAX ? get_block (pool, 0) : SIZE_MAX;
+  spinlock_release (&pool->lock);
+  if (page_idx == SIZE_MAX)
+    return;
+
+  page = pool->base + PGSIZE * page_idx;
+  start = timer_cycles ();
+  memset (page, 0, PGSIZE);
+
+  spinlock_acquire (&zero_lock);
+  zero_bg_pages++;
+  zero_bg_cycles += timer_cycles () - start;
+  spinlock_release (&zero_lock);
+
+  spinlock_acquire (&pool->lock);
+  if (pool->zeroed_cnt < ZEROED_MAX)
+    pool->zeroed[pool->zeroed_cnt++] = page;
+  else
+    free_range (pool, page_idx, 1);
+  spinlock_release (&pool->lock);
+}
@@ -0,0 +1,286 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A slab is a single page.  It starts with a struct slab, then
+   an array of the indexes of its free objects, used as a stack,
+   then some padding that depends on the slab's color, and then
+   the objects themselves.
+
+   Keeping the free objects' indexes outside the objects, rather
+   than threading a free list through them, is what lets a free
+   object stay in its constructed state. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Distance between the first objects of slabs of adjacent
+   colors.  The size of a cache line. */
+#define COLOR_STEP 64
+
+/* A slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    uint8_t *objs;              /* First object. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free_idx[];        /* Indexes of free objects. */
+  };
+
+/* All the object caches, for statistics. */
+static struct list caches;
+static struct lock caches_lock;
+
+static struct slab *new_slab (struct kmem_cache *);
+static void free_slab (struct slab *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Initializes the object cache allocator. */
+void
+slab_init (void)
+{
+  list_init (&caches);
+  lock_init (&caches_lock);
+}
+
+/* Creates and returns a cache of objects of SIZE bytes, aligned
+   on multiples of ALIGN bytes, which must be a power of 2 no
+   larger than COLOR_STEP, or 0 for word alignment.  If CTOR is
+   nonnull, it is called to initialize each object when its slab
+   is allocated.  NAME identifies the cache in statistics.
+   Returns a null pointer if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  size_t n, leftover;
+
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT (size > 0);
+  ASSERT ((align & (align - 1)) == 0 && align <= COLOR_STEP);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, align);
+  c->align = align;
+  c->ctor = ctor;
+
+  /* Fit in as many objects as we can, along with their free
+     indexes. */
+  n = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  ASSERT (n > 0);
+  for (;;)
+    {
+      c->first_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                               align);
+      if (c->first_ofs + n * c->obj_size <= PGSIZE)
+        break;
+      n--;
+    }
+  c->objs_per_slab = n;
+  leftover = PGSIZE - c->first_ofs - n * c->obj_size;
+  c->color_cnt = leftover / COLOR_STEP + 1;
+  c->next_color = 0;
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->slab_cnt = 0;
+  c->in_use = 0;
+  c->peak_in_use = 0;
+
+  lock_acquire (&caches_lock);
+  list_push_back (&caches, &c->elem);
+  lock_release (&caches_lock);
+  return c;
+}
+
+/* Destroys cache C, which must have no objects allocated, and
+   frees its memory. */
+void
+kmem_cache_destroy (struct kmem_cache *c)
+{
+  if (c == NULL)
+    return;
+
+  ASSERT (c->in_use == 0);
+  lock_acquire (&caches_lock);
+  list_remove (&c->elem);
+  lock_release (&caches_lock);
+
+  lock_acquire (&c->lock);
+  while (!list_empty (&c->empty))
+    free_slab (list_entry (list_pop_front (&c->empty), struct slab, elem));
+  lock_release (&c->lock);
+  free (c);
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty))
+        s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      else
+        {
+          s = new_slab (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  obj = s->objs + s->free_idx[--s->free_cnt] * c->obj_size;
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C and
+   be in its constructed state, to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     that would destroy its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  s->free_idx[s->free_cnt++] = ((uint8_t *) obj - s->objs) / c->obj_size;
+  c->in_use--;
+  if (s->free_cnt == 1 || s->free_cnt == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      if (s->free_cnt < c->objs_per_slab)
+        list_push_front (&c->partial, &s->elem);
+      else if (list_empty (&c->empty))
+        list_push_front (&c->empty, &s->elem);
+      else
+        {
+          /* Keep one empty slab around, so that a cache whose
+             use goes back and forth across a slab boundary does
+             not allocate and free a page every time. */
+          free_slab (s);
+        }
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each object cache, including how much
+   memory the objects in use would take from malloc() instead. */
+void
+kmem_cache_print_stats (void)
+{
+  struct list_elem *e;
+
+  lock_acquire (&caches_lock);
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      size_t malloc_size = malloc_round_size (c->obj_size);
+
+      printf ("Slab: %s: %zu %zu-byte objects in use (peak %zu), "
+              "%zu slabs of %zu, %zu bytes (%zu with malloc)\n",
+              c->name, c->in_use, c->obj_size, c->peak_in_use,
+              c->slab_cnt, c->objs_per_slab, c->slab_cnt * PGSIZE,
+              c->in_use * malloc_size);
+    }
+  lock_release (&caches_lock);
+}
+
+/* Allocates a new slab for cache C, constructing its objects,
+   and returns it.  Returns a null pointer if memory is not
+   available.  C's lock must be held. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = (uint8_t *) s + c->first_ofs + c->next_color * COLOR_STEP;
+  c->next_color = (c->next_color + 1) % c->color_cnt;
+
+  /* Push the indexes in reverse, so that objects come out in
+     address order. */
+  s->free_cnt = c->objs_per_slab;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->free_idx[i] = c->objs_per_slab - i - 1;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Frees slab S, which must have no objects in use and must not
+   be in any list.  Its cache's lock must be held. */
+static void
+free_slab (struct slab *s)
+{
+  ASSERT (s->free_cnt == s->cache->objs_per_slab);
+  s->cache->slab_cnt--;
+  s->magic = 0;
+  palloc_free_page (s);
+}
+
+/* Returns the slab that contains OBJ, which must have been
+   allocated from cache C. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+  return s;
+}
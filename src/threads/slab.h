@@ -0,0 +1,63 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Object caches.
+
+   malloc() rounds each request up to one of a fixed set of size
+   classes, so a kernel object that falls just past a class
+   boundary wastes the rest of its block.  An object cache
+   instead hands out objects of one fixed size, packed into
+   "slabs" of one page each with only a small header, and keeps
+   the slabs that it has allocated on one of three lists: full,
+   partially used, and empty.  kmem_cache_print_stats() shows
+   how much memory the same objects would take from malloc().
+
+   A cache may have a constructor, which is called on each object
+   when the slab that holds it is first allocated, and never
+   again.  kmem_cache_free() expects the object to be back in its
+   constructed state, so that the next kmem_cache_alloc() can
+   hand it out without initializing it again.
+
+   Each new slab starts its objects at a different offset within
+   its page, cycling through the space that the objects leave
+   over, so that the same object in different slabs does not
+   always map to the same cache lines ("cache coloring"). */
+
+/* Initializes an object in a cache. */
+typedef void kmem_ctor_func (void *obj);
+
+/* An object cache. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in list of all caches. */
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object, rounded to ALIGN. */
+    size_t align;               /* Object alignment. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t first_ofs;           /* Offset of first object, uncolored. */
+    size_t color_cnt;           /* Number of different offsets. */
+    size_t next_color;          /* Offset index for the next slab. */
+
+    struct lock lock;           /* Protects the fields below. */
+    struct list partial;        /* Slabs with some objects in use. */
+    struct list full;           /* Slabs with all objects in use. */
+    struct list empty;          /* Slabs with no objects in use. */
+    size_t slab_cnt;            /* Number of slabs on all three lists. */
+    size_t in_use;              /* Number of objects allocated. */
+    size_t peak_in_use;         /* Most objects ever allocated at once. */
+  };
+
+void slab_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *);
+void kmem_cache_destroy (struct kmem_cache *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
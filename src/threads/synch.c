@@ -32,6 +32,10 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static heap_less_func sema_waiter_less;
+static heap_less_func cond_waiter_less;
+static void donor_init (struct donor *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -48,7 +52,20 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   sema->holder = NULL;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, sema_waiter_less, NULL);
+}
+
+/* Returns true if waiting thread A should be woken before B,
+   that is, if it has a higher priority.  Equal priorities are
+   woken in the order they started waiting. */
+static bool
+sema_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, heap_elem);
+  const struct thread *b = heap_entry (b_, struct thread, heap_elem);
+
+  return a->priority > b->priority;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -69,10 +86,10 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0)
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      heap_insert (&sema->waiters, &thread_current ()->heap_elem);
+      thread_current ()->wait_queue = &sema->waiters;
       thread_current ()->waiting = sema->holder;
-      if (sema->holder != NULL)
-        setup_priority_donation (sema->holder->holder);
+      thread_donate_priority (thread_current ());
       thread_block ();
     }
   sema->value--;
@@ -117,14 +134,20 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)){
-		struct list_elem *max = list_max (&sema->waiters, priority_thread_less, NULL);
-		list_remove(max);
-    thread_unblock (list_entry (max, struct thread, elem));
-	}
+  if (!heap_empty (&sema->waiters))
+    {
+      struct thread *t = heap_entry (heap_pop_min (&sema->waiters),
+                                     struct thread, heap_elem);
+      t->wait_queue = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);
-  thread_yield ();
+
+  /* Give way only if a thread that should run instead of us is
+     now ready: the one we woke, or, if lock_release() just
+     dropped our donated priority, any other. */
+  thread_preempt_if_needed ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -164,6 +187,15 @@ sema_test_helper (void *sema_)
     }
 }
 
+/* Initializes donor D, for a lock that is not held. */
+static void
+donor_init (struct donor *d)
+{
+  d->priority = PRI_MIN - 1;
+  d->parent = d->left = d->right = NULL;
+  d->rank = 0;
+}
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -187,6 +219,7 @@ lock_init (struct lock *lock)
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
   (&lock->semaphore)->holder = lock;
+  donor_init (&lock->donor);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -200,13 +233,20 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  /* Keep interrupts off until the holder is recorded, so that no
+     waiter can find the lock taken but without a holder to
+     donate to. */
+  old_level = intr_disable ();
   sema_down (&lock->semaphore);
-  list_push_back (&thread_current ()->locks, &lock->elem);
   lock->holder = thread_current ();
+  thread_lock_acquired (lock);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -218,16 +258,20 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
-  if (success){
-		list_push_back (&thread_current ()->locks, &lock->elem);
-    lock->holder = thread_current ();
-	}
+  if (success)
+    {
+      lock->holder = thread_current ();
+      thread_lock_acquired (lock);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -239,16 +283,18 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Drop the donations received through LOCK before waking a
+     waiter, so that sema_up() yields to it if it now outranks
+     us. */
+  old_level = intr_disable ();
+  thread_lock_released (lock);
   lock->holder = NULL;
-  list_remove(&lock->elem);
   sema_up (&lock->semaphore);
-
-  enum intr_level old_level;
-  old_level = intr_disable ();
-  setup_priority_donation (thread_current());
   intr_set_level (old_level);
 }
 
@@ -263,12 +309,14 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* One semaphore in a condition variable's wait queue. */
 struct semaphore_elem
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Wait queue element. */
+    struct list_elem list_elem;         /* Element in arrivals list. */
     struct semaphore semaphore;         /* This semaphore. */
-		int priority;                       /* Semaphore element priority. */
+    struct thread *thread;              /* Waiting thread. */
+    int priority;                       /* Key: the thread's priority. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -279,7 +327,23 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, cond_waiter_less, NULL);
+  list_init (&cond->arrivals);
+}
+
+/* Returns true if condition waiter A should be signaled before
+   B.  The priority is a copy of the waiting thread's, kept up to
+   date by synch_requeue(), because the thread's own priority may
+   change without notice while it is between the queue and
+   blocking on its semaphore. */
+static bool
+cond_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem, elem);
+
+  return a->priority > b->priority;
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -305,8 +369,9 @@ cond_init (struct condition *cond)
 void
 cond_wait (struct condition *cond, struct lock *lock)
 {
+  struct thread *cur = thread_current ();
   struct semaphore_elem waiter;
-	waiter.priority = thread_current ()->priority;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -314,22 +379,19 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
 
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = cur;
+  old_level = intr_disable ();
+  waiter.priority = cur->priority;
+  heap_insert (&cond->waiters, &waiter.elem);
+  list_push_back (&cond->arrivals, &waiter.list_elem);
+  cur->cond_queue = &cond->waiters;
+  cur->cond_elem = &waiter.elem;
+  intr_set_level (old_level);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
-/* Comparing semaphore_elem priorities. */
-bool
-priority_sema_less (const struct list_elem *a, const struct list_elem *b, void *aux)
-{
-  struct semaphore_elem *t1 = list_entry (a, struct semaphore_elem, elem);
-  struct semaphore_elem *t2 = list_entry (b, struct semaphore_elem, elem);
-  return t1->priority < t2->priority;
-}
-
-
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -345,13 +407,73 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) {
-		struct list_elem *max = list_max (&cond->waiters, priority_sema_less, NULL);
-		struct semaphore_elem *s = list_entry (max, struct semaphore_elem, elem);
+  if (!heap_empty (&cond->waiters))
+    {
+      enum intr_level old_level = intr_disable ();
+      struct semaphore_elem *waiter
+        = heap_entry (heap_pop_min (&cond->waiters),
+                      struct semaphore_elem, elem);
+      list_remove (&waiter->list_elem);
+      waiter->thread->cond_queue = NULL;
+      intr_set_level (old_level);
+      sema_up (&waiter->semaphore);
+    }
+}
+
+/* Marks the thread waiting on condition waiter E as no longer
+   in the queue.  Helper for cond_broadcast(). */
+static void
+cond_detach_waiter (struct heap_elem *e, void *aux UNUSED)
+{
+  struct semaphore_elem *waiter = heap_entry (e, struct semaphore_elem, elem);
+
+  waiter->thread->cond_queue = NULL;
+}
+
+/* Returns the index of the lowest set bit in X, which must be
+   nonzero.  Split into 32-bit halves so that each half is a
+   single BSF instruction. */
+static int
+lowest_bit (uint64_t x)
+{
+  uint32_t low = x;
+
+  if (low != 0)
+    return __builtin_ctz (low);
+  else
+    return 32 + __builtin_ctz ((uint32_t) (x >> 32));
+}
 
-		list_remove(max);
-    sema_up (&list_entry (max, struct semaphore_elem, elem)->semaphore);
-	}
+/* Moves the waiters on COND's arrivals list to WOKEN, in the
+   order in which cond_signal() would pick them: highest priority
+   first, and oldest first within a priority.  This is a stable
+   bucket pass in O(n) time.  LAST[P] is the waiter of priority P
+   most recently moved, and bit P of PRESENT says whether there
+   is one yet, so each waiter goes right after the last one of
+   its own priority or, failing that, after the last one of the
+   next higher priority present. */
+static void
+cond_sort_waiters (struct condition *cond, struct list *woken)
+{
+  struct list_elem *last[PRI_MAX + 1];
+  uint64_t present = 0;
+
+  while (!list_empty (&cond->arrivals))
+    {
+      struct list_elem *e = list_pop_front (&cond->arrivals);
+      int p = list_entry (e, struct semaphore_elem, list_elem)->priority;
+      uint64_t higher = present & ~(((uint64_t) 2 << p) - 1);
+
+      ASSERT (p >= PRI_MIN && p <= PRI_MAX);
+      if (present & ((uint64_t) 1 << p))
+        list_insert (list_next (last[p]), e);
+      else if (higher != 0)
+        list_insert (list_next (last[lowest_bit (higher)]), e);
+      else
+        list_push_front (woken, e);
+      last[p] = e;
+      present |= (uint64_t) 1 << p;
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -363,9 +485,362 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
 void
 cond_broadcast (struct condition *cond, struct lock *lock)
 {
+  enum intr_level old_level;
+  struct list woken;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  /* Empty the queue in one pass, then wake the waiters in the
+     same order that signaling them one by one would.  Waking may
+     switch threads, so the queue is detached first. */
+  list_init (&woken);
+  old_level = intr_disable ();
+  heap_clear (&cond->waiters, cond_detach_waiter, NULL);
+  cond_sort_waiters (cond, &woken);
+  intr_set_level (old_level);
+
+  while (!list_empty (&woken))
+    {
+      struct semaphore_elem *waiter
+        = list_entry (list_pop_front (&woken), struct semaphore_elem,
+                      list_elem);
+      sema_up (&waiter->semaphore);
+    }
+}
+
+/* Initializes readers-writer lock RW as free.  RW may be held
+   for reading by any number of threads at once, or for writing
+   by a single thread.  Like locks, readers-writer locks are not
+   recursive, and the thread that acquires one must release it.
+
+   A thread that must wait for RW donates its priority to every
+   thread holding it, readers included. */
+void
+rw_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->writer = NULL;
+  rw->reader_cnt = 0;
+  list_init (&rw->readers);
+  heap_init (&rw->read_waiters, sema_waiter_less, NULL);
+  heap_init (&rw->write_waiters, sema_waiter_less, NULL);
+  donor_init (&rw->donor);
+}
+
+/* Returns true if a thread may start reading RW right away.
+   Readers also wait while a writer is waiting, to keep writers
+   from starving. */
+static bool
+rw_can_read (struct rwlock *rw)
+{
+  return rw->writer == NULL && heap_empty (&rw->write_waiters);
+}
+
+/* Returns true if a thread may start writing RW right away. */
+static bool
+rw_can_write (struct rwlock *rw)
+{
+  return rw->writer == NULL && rw->reader_cnt == 0;
+}
+
+/* Puts the running thread to sleep in WAITERS, one of RW's wait
+   queues, until whoever releases RW hands it over.  Interrupts
+   must be off. */
+static void
+rw_wait (struct rwlock *rw, struct heap *waiters)
+{
+  struct thread *cur = thread_current ();
+
+  heap_insert (waiters, &cur->heap_elem);
+  cur->wait_queue = waiters;
+  cur->waiting_rw = rw;
+  thread_donate_priority (cur);
+  thread_block ();
+}
+
+/* Moves waiting thread E onto the list AUX.  Helper for
+   rw_hand_off(). */
+static void
+rw_take_reader (struct heap_elem *e, void *aux)
+{
+  struct thread *t = heap_entry (e, struct thread, heap_elem);
+  struct list *readers = aux;
+
+  list_push_back (readers, &t->elem);
+}
+
+/* Hands RW, which has just become free, to the threads waiting
+   for it: the first waiting writer if there is one, otherwise
+   all the waiting readers.  Interrupts must be off. */
+static void
+rw_hand_off (struct rwlock *rw)
+{
+  ASSERT (rw_can_write (rw));
+
+  if (!heap_empty (&rw->write_waiters))
+    {
+      struct thread *t = heap_entry (heap_pop_min (&rw->write_waiters),
+                                     struct thread, heap_elem);
+      t->wait_queue = NULL;
+      rw->writer = t;
+      thread_rwlock_acquired (rw, t);
+      thread_unblock (t);
+    }
+  else if (!heap_empty (&rw->read_waiters))
+    {
+      struct list readers;
+
+      /* Empty the queue first, so that no reader is handed
+         donations from the others. */
+      list_init (&readers);
+      heap_clear (&rw->read_waiters, rw_take_reader, &readers);
+
+      while (!list_empty (&readers))
+        {
+          struct thread *t = list_entry (list_pop_front (&readers),
+                                         struct thread, elem);
+          t->wait_queue = NULL;
+          rw->reader_cnt++;
+          thread_rwlock_acquired (rw, t);
+          thread_unblock (t);
+        }
+    }
+}
+
+/* Acquires RW for reading, sleeping until it becomes available
+   if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_read_acquire (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw_can_read (rw))
+    {
+      rw->reader_cnt++;
+      thread_rwlock_acquired (rw, thread_current ());
+    }
+  else
+    rw_wait (rw, &rw->read_waiters);
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading and returns true if successful
+   or false on failure.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+rw_read_try_acquire (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw_can_read (rw);
+  if (success)
+    {
+      rw->reader_cnt++;
+      thread_rwlock_acquired (rw, thread_current ());
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rw_read_release (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->reader_cnt > 0);
+
+  old_level = intr_disable ();
+  thread_rwlock_released (rw);
+  if (--rw->reader_cnt == 0)
+    rw_hand_off (rw);
+  intr_set_level (old_level);
+  thread_preempt_if_needed ();
+}
+
+/* Acquires RW for writing, sleeping until it becomes available
+   if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_write_acquire (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw_can_write (rw))
+    {
+      rw->writer = thread_current ();
+      thread_rwlock_acquired (rw, rw->writer);
+    }
+  else
+    rw_wait (rw, &rw->write_waiters);
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing and returns true if successful
+   or false on failure.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+rw_write_try_acquire (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  success = rw_can_write (rw);
+  if (success)
+    {
+      rw->writer = thread_current ();
+      thread_rwlock_acquired (rw, rw->writer);
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rw_write_release (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw_write_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  thread_rwlock_released (rw);
+  rw->writer = NULL;
+  rw_hand_off (rw);
+  intr_set_level (old_level);
+  thread_preempt_if_needed ();
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rw_write_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Called by thread_update_priority() after the priority of T has
+   changed, to keep T in order in the wait queues it is in.
+   Interrupts must be off. */
+void
+synch_requeue (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->wait_queue != NULL)
+    heap_rekey (t->wait_queue, &t->heap_elem);
+  if (t->cond_queue != NULL)
+    {
+      struct semaphore_elem *waiter
+        = heap_entry (t->cond_elem, struct semaphore_elem, elem);
+      waiter->priority = t->priority;
+      heap_rekey (t->cond_queue, t->cond_elem);
+    }
+}
+
+/* Initializes spin lock LOCK as unlocked. */
+void
+spinlock_init (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
-    cond_signal (cond, lock);
+  lock->locked = 0;
+}
+
+/* Atomically sets *LOCKED to 1 and returns its old value.  The
+   XCHG instruction with a memory operand is implicitly locked.
+   See [IA32-v2b] "XCHG". */
+static inline int
+spinlock_xchg (volatile int *locked)
+{
+  int old = 1;
+  asm volatile ("xchgl %0, %1" : "+r" (old), "+m" (*locked) : : "memory");
+  return old;
+}
+
+/* Disables interrupts and acquires LOCK, spinning until it is
+   available. */
+void
+spinlock_acquire (struct spinlock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+
+  old_level = intr_disable ();
+  while (spinlock_xchg (&lock->locked) != 0)
+    while (lock->locked)
+      asm volatile ("pause");
+  lock->old_level = old_level;
+}
+
+/* Tries to acquire LOCK without spinning.  On success, returns
+   true with interrupts disabled.  On failure, returns false and
+   leaves the interrupt level unchanged. */
+bool
+spinlock_try_acquire (struct spinlock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+
+  old_level = intr_disable ();
+  if (spinlock_xchg (&lock->locked) != 0)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  lock->old_level = old_level;
+  return true;
+}
+
+/* Releases LOCK and restores the interrupt level from before it
+   was acquired. */
+void
+spinlock_release (struct spinlock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (lock->locked);
+
+  old_level = lock->old_level;
+  barrier ();
+  lock->locked = 0;
+  intr_set_level (old_level);
 }
@@ -1,14 +1,18 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include "threads/interrupt.h"
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
     struct lock *holder;        /* Lock holding semaphore (for priority donation). */
   };
 
@@ -18,12 +22,23 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Priority donation that the holder of a lock receives from the
+   threads waiting on it.  Owned by thread.c. */
+struct donor
+  {
+    int priority;               /* Highest priority among waiters. */
+    struct donor *parent;       /* Parent in holder's donor heap. */
+    struct donor *left;         /* Left child in holder's donor heap. */
+    struct donor *right;        /* Right child in holder's donor heap. */
+    int rank;                   /* Leftist heap rank, 0 if not in a heap. */
+  };
+
 /* Lock. */
 struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
-    struct list_elem elem;      /* List element. */
+    struct donor donor;         /* Priority donation to holder. */
   };
 
 void lock_init (struct lock *);
@@ -35,7 +50,8 @@ bool lock_held_by_current_thread (const struct lock *);
 /* Condition variable. */
 struct condition
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting semaphore_elems, by priority. */
+    struct list arrivals;       /* Same waiters, oldest first. */
   };
 
 void cond_init (struct condition *);
@@ -43,8 +59,59 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-/* comparing priority of threads*/
-bool priority_thread_less (const struct list_elem *a, const struct list_elem *b, void *aux); 
+/* Readers-writer lock.  Any number of readers or a single
+   writer may hold it at once.  Writers are preferred: once a
+   writer is waiting, new readers wait behind it, so a steady
+   stream of readers cannot starve writers. */
+struct rwlock
+  {
+    struct thread *writer;      /* Thread holding it for writing, or null. */
+    unsigned reader_cnt;        /* # of threads holding it for reading. */
+    struct list readers;        /* Readers' rw_holds. */
+    struct heap read_waiters;   /* Threads waiting to read, by priority. */
+    struct heap write_waiters;  /* Threads waiting to write, by priority. */
+    struct donor donor;         /* Priority donation to writer. */
+  };
+
+/* Maximum number of readers-writer locks that one thread may
+   hold for reading at the same time. */
+#define RW_READ_MAX 4
+
+/* One thread's read hold on a readers-writer lock.  Owned by
+   thread.c. */
+struct rw_hold
+  {
+    struct rwlock *rwlock;      /* Lock held for reading, or null if free. */
+    struct thread *thread;      /* Thread holding it. */
+    struct list_elem elem;      /* Element in rwlock's `readers'. */
+    struct donor donor;         /* Priority donation to THREAD. */
+  };
+
+void rw_init (struct rwlock *);
+void rw_read_acquire (struct rwlock *);
+bool rw_read_try_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+bool rw_write_try_acquire (struct rwlock *);
+void rw_write_release (struct rwlock *);
+bool rw_write_held_by_current_thread (const struct rwlock *);
+
+void synch_requeue (struct thread *);
+
+/* Spin lock.  Disables interrupts on the local CPU while held,
+   so it may be used in interrupt handlers, and busy-waits for
+   other CPUs.  Critical sections must be short and must not
+   sleep. */
+struct spinlock
+  {
+    volatile int locked;        /* Nonzero while held. */
+    enum intr_level old_level;  /* Interrupt level before acquire. */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
 
 /* Optimization barrier.
 
@@ -1,17 +1,25 @@
 #include "threads/thread.h"
 #include <float.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -21,23 +29,35 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, are kept in per-CPU run
+   queues in struct cpu.  A thread is queued on the CPU in its
+   `cpu' member. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Final accounting of a thread that has exited, kept for the
+   table printed by thread_print_stats(). */
+struct exited_thread
+  {
+    struct list_elem elem;      /* Element in exited_list. */
+    tid_t tid;                  /* Thread identifier. */
+    char name[16];              /* Name. */
+    struct thread_stats stats;  /* Accounting at exit. */
+  };
+
+/* Exited threads, oldest first, if thread_stats_table is true.
+   Protected by disabling interrupts. */
+static struct list exited_list;
+
+/* If true, keep every thread's accounting for the table. */
+bool thread_stats_table;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame
   {
@@ -46,35 +66,152 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+/* Statistics, in time-stamp counter cycles. */
+static uint64_t idle_cycles;    /* # of cycles spent idle. */
+static uint64_t kernel_cycles;  /* # of cycles in kernel threads. */
+static uint64_t user_cycles;    /* # of cycles in user programs. */
+
+/* Context switch statistics. */
+static unsigned switches_blocked;   /* # of switches away from blocked threads. */
+static unsigned switches_yielded;   /* # of switches on voluntary yields. */
+static unsigned switches_preempted; /* # of switches on preemption. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+
+/* Scheduling class.  A class keeps the ready threads of each CPU
+   in its own part of struct cpu and decides which of them runs
+   next.  All but `tick' are called with the CPU's run queue lock
+   held.  The MLFQS scheduler is the priority class with
+   priorities computed by thread_mlfqs_tick(). */
+struct sched_class
+  {
+    void (*enqueue) (struct cpu *, struct thread *); /* Adds a ready thread. */
+    void (*dequeue) (struct cpu *, struct thread *); /* Removes a ready thread. */
+    struct thread *(*pick) (struct cpu *);      /* Next to run, or null. */
+    bool (*preempts) (struct cpu *, struct thread *); /* Should T give way? */
+    void (*tick) (struct thread *);             /* Charges T for a tick. */
+  };
+
+static const struct sched_class priority_class;
+static const struct sched_class stride_class;
+
+/* The scheduling class in use. */
+static const struct sched_class *sched;
+
+/* Stride of a thread with a single ticket.  Under the stride
+   scheduler a thread holds one ticket per priority level above
+   PRI_MIN - 1, so a thread at PRI_MAX gets 64 times the CPU time
+   of a thread at PRI_MIN.  Donated priority donates tickets. */
+#define STRIDE1 (1 << 20)
+
+/* Periodic real-time threads, created by
+   thread_create_periodic(), form a class of their own above all
+   priorities.  They are kept in a separate run queue on each
+   CPU, a min-heap on deadline, and whenever any of them is ready
+   the one with the earliest deadline runs (EDF).
+
+   Each one runs a job, a call to its function, once per period,
+   and may use at most its budget of timer ticks per job.  A job
+   that runs out of budget is suspended until the next period
+   starts.  A job is late if it has not finished by the start of
+   the next period. */
+struct rt_thread
+  {
+    thread_func *function;      /* Job to run each period. */
+    void *aux;                  /* Auxiliary data for FUNCTION. */
+    int64_t period;             /* Ticks between releases. */
+    int64_t budget;             /* Ticks of CPU time per job. */
+    int utilization;            /* BUDGET / PERIOD, in thousandths. */
+    int64_t release;            /* Tick the current job was released. */
+    int64_t deadline;           /* Tick the current job is due. */
+    int64_t used;               /* Ticks used by the current job. */
+    bool done;                  /* Current job has finished? */
+    int64_t release_ns;         /* timer_ns() at release, 0 once started. */
+    struct timer_elem timer;    /* Releases the next job. */
+  };
+
+/* Admission control.  EDF meets every deadline on one CPU as long
+   as the periodic threads' utilizations add up to at most 1, and
+   RT_UTIL_MAX keeps a little of that for everything else. */
+#define RT_UTIL_MAX 900         /* In thousandths. */
+static int rt_utilization;      /* Sum over periodic threads. */
+
+/* Real-time statistics. */
+static unsigned rt_releases;    /* # of jobs released. */
+static unsigned rt_missed;      /* # of jobs that missed their deadline. */
+static unsigned rt_overruns;    /* # of times a job ran out of budget. */
+static int64_t rt_jitter_ns;    /* Total delay from release to start. */
+static int64_t rt_jitter_max_ns; /* Longest delay from release to start. */
+
+/* Maximum number of nested locks that a priority donation is
+   propagated through.  Controlled by "-donate-depth=N". */
+int thread_donation_depth = DONATION_DEPTH_DEFAULT;
+
+/* Maximum number of free thread pages that each CPU keeps for
+   reuse.  Controlled by "-thread-cache=N". */
+int thread_cache_max = THREAD_CACHE_DEFAULT;
+
+/* Number of ready threads that the MLFQS decay updates each time
+   it takes a run queue lock.  Controlled by "-decay-batch=N". */
+int thread_decay_batch = DECAY_BATCH_DEFAULT;
+
 /* Often known as the system load average.
    Estimates the average number of threads ready to run over the past minute. */
-struct float32 load_avg;
+static struct float64 load_avg;
+
+/* MLFQS recent_cpu decay.  Once a second every thread's recent_cpu
+   is multiplied by a coefficient that depends on load_avg.  Only
+   the running and ready threads are decayed right away.  A blocked
+   thread catches up when it is next unblocked, by replaying the
+   coefficients of the seconds it missed, which are kept for the
+   last DECAY_HISTORY seconds. */
+#define DECAY_HISTORY 64
+static struct float64 decay_history[DECAY_HISTORY];
+static int64_t decay_epoch;     /* # of decays so far. */
+static struct work decay_work;  /* Decays the ready threads. */
 
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static void yield (bool preempted);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct cpu *, struct thread *);
+static void ready_queue_init (struct cpu *);
+static void ready_queue_insert (struct cpu *, struct thread *);
+static void ready_queue_delete (struct cpu *, struct thread *);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (struct cpu *);
+static heap_less_func stride_less;
+static heap_less_func rt_less;
+static struct thread *ready_queue_pick (struct cpu *);
+static struct thread *ready_queue_steal (struct cpu *);
+static bool ready_queue_preempts (struct cpu *, struct thread *);
+static void rt_release (void *);
+static struct cpu *cpu_pick (void);
+static bool cpu_busy (struct cpu *);
+static void mlfqs_catch_up (struct thread *);
+static int mlfqs_priority (struct thread *);
+static work_func mlfqs_decay;
 
 
 /* Initializes the threading system by transforming the code
@@ -82,7 +219,7 @@ static tid_t allocate_tid (void);
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues and the tid lock.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -93,19 +230,26 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
-  list_init (&all_list);
+  if (thread_mlfqs && thread_stride)
+    PANIC ("-mlfqs and -stride cannot be used together");
+  sched = thread_stride ? &stride_class : &priority_class;
 
-	load_avg = to_float(0);
+  for (i = 0; i < CPU_MAX; i++)
+    ready_queue_init (&cpus[i]);
+  list_init (&all_list);
+  list_init (&exited_list);
+  work_init (&decay_work, mlfqs_decay, NULL);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  cpus[0].account_start = timer_cycles ();
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -125,46 +269,233 @@ thread_start (void)
   sema_down (&idle_started);
 }
 
+/* Turns the code running on application processor C, on the
+   stack it was started on, into C's idle thread and puts C
+   online, so that new threads may be sent to it.  Called by
+   cpu_ap_main() with interrupts off. */
+void
+thread_start_ap (struct cpu *c)
+{
+  struct thread *t = running_thread ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  init_thread (t, "idle", PRI_MIN);
+  t->status = THREAD_RUNNING;
+  t->tid = allocate_tid ();
+  t->cpu = c;
+  c->idle_thread = t;
+  c->account_start = timer_cycles ();
+  c->online = true;
+
+  idle_loop ();
+}
+
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void
 thread_tick (void)
 {
   struct thread *t = thread_current ();
+  struct cpu *c = t->cpu;
+
+  if (t->rt != NULL)
+    {
+      /* Suspend the job in thread_yield() once its budget is
+         used up. */
+      if (++t->rt->used >= t->rt->budget)
+        intr_yield_on_return ();
+    }
+  else if (t != c->idle_thread)
+    {
+      t->recent_cpu++;
+      if (sched->tick != NULL)
+        sched->tick (t);
+    }
+
+  /* Enforce preemption. */
+  if (++c->thread_ticks >= TIME_SLICE)
+    intr_yield_on_return ();
+}
+
+/* Called by the local APIC timer interrupt handler at each timer
+   tick of an application processor.  The global tick count and
+   the once a second MLFQS update belong to the bootstrap
+   processor's timer, so this only charges the running thread for
+   the tick and, under the MLFQS, recomputes its priority every
+   fourth tick. */
+void
+thread_ap_tick (void)
+{
+  struct thread *cur = thread_current ();
+  struct cpu *c = cur->cpu;
+
+  ASSERT (intr_context ());
+
+  if (thread_mlfqs)
+    mlfqs_catch_up (cur);
+  thread_tick ();
+  if (thread_mlfqs && ++c->local_ticks % 4 == 0)
+    {
+      if (!is_idle_thread (cur))
+        thread_update_priority (cur, mlfqs_priority (cur));
+      intr_yield_on_return ();
+    }
+}
+
+/* Charges the CPU time since the last call to T, which must be
+   the running thread.  Interrupts must be off. */
+static void
+thread_account (struct thread *t)
+{
+  struct cpu *c = t->cpu;
+  uint64_t now = timer_cycles ();
+  uint64_t cycles = now - c->account_start;
 
-  /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  c->account_start = now;
+  t->cpu_cycles += cycles;
+  if (t == c->idle_thread)
+    {
+      idle_cycles += cycles;
+      c->idle_cycles += cycles;
+    }
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    user_cycles += cycles;
 #endif
   else
-    kernel_ticks++;
+    kernel_cycles += cycles;
+}
 
-  if (t != idle_thread)
-    t->recent_cpu++;
+/* Returns the CPU time that T has used, in nanoseconds. */
+int64_t
+thread_cpu_time (struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t cycles;
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
-    intr_yield_on_return ();
+  if (t == thread_current ())
+    thread_account (t);
+  cycles = t->cpu_cycles;
+  intr_set_level (old_level);
+
+  return timer_cycles_to_ns (cycles);
 }
 
-/* Prints thread statistics. */
+/* Stores T's accounting in *S.  Time spent in T's current state
+   up to now is included. */
 void
-thread_print_stats (void)
+thread_get_stats (struct thread *t, struct thread_stats *s)
 {
-  printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-          idle_ticks, kernel_ticks, user_ticks);
+  enum intr_level old_level = intr_disable ();
+  uint64_t now = timer_cycles ();
+  uint64_t ready = t->ready_cycles;
+  uint64_t blocked = t->blocked_cycles;
+  uint64_t donated = t->donated_cycles;
+
+  if (t == thread_current ())
+    thread_account (t);
+  if (t->status == THREAD_READY)
+    ready += now - t->state_start;
+  else if (t->status == THREAD_BLOCKED)
+    blocked += now - t->state_start;
+  if (t->donated_start != 0)
+    donated += now - t->donated_start;
+
+  s->run_ns = timer_cycles_to_ns (t->cpu_cycles);
+  s->ready_ns = timer_cycles_to_ns (ready);
+  s->blocked_ns = timer_cycles_to_ns (blocked);
+  s->donated_ns = timer_cycles_to_ns (donated);
+  s->voluntary_switches = t->voluntary_switches;
+  s->involuntary_switches = t->involuntary_switches;
+  intr_set_level (old_level);
 }
 
-/* Comparing thread priorities. */
-bool
-priority_thread_less (const struct list_elem *a, const struct list_elem *b, void *aux)
+/* Prints one row of the thread accounting table. */
+static void
+print_stats_row (tid_t tid, const char *name, const struct thread_stats *s)
+{
+  printf ("%5d %-16s %10"PRId64" %10"PRId64" %10"PRId64" %10"PRId64
+          " %8u %8u\n",
+          tid, name, s->run_ns / 1000, s->ready_ns / 1000,
+          s->blocked_ns / 1000, s->donated_ns / 1000,
+          s->voluntary_switches, s->involuntary_switches);
+}
+
+/* Prints the accounting of every thread, live or exited, in
+   microseconds. */
+static void
+print_stats_table (void)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  printf ("%5s %-16s %10s %10s %10s %10s %8s %8s\n",
+          "tid", "name", "run us", "ready us", "block us", "donate us",
+          "vol", "invol");
+
+  old_level = intr_disable ();
+  for (e = list_begin (&exited_list); e != list_end (&exited_list);
+       e = list_next (e))
+    {
+      struct exited_thread *x = list_entry (e, struct exited_thread, elem);
+      print_stats_row (x->tid, x->name, &x->stats);
+    }
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread_stats s;
+
+      thread_get_stats (t, &s);
+      print_stats_row (t->tid, t->name, &s);
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints thread statistics. */
+void
+thread_print_stats (void)
 {
-  struct thread *t1 = list_entry (a, struct thread, elem);
-  struct thread *t2 = list_entry (b, struct thread, elem);
-  return t1->priority < t2->priority;
+  enum intr_level old_level = intr_disable ();
+  thread_account (thread_current ());
+  intr_set_level (old_level);
+
+  printf ("Thread: %"PRId64" ms idle, %"PRId64" ms kernel, "
+          "%"PRId64" ms user\n",
+          timer_cycles_to_ns (idle_cycles) / 1000000,
+          timer_cycles_to_ns (kernel_cycles) / 1000000,
+          timer_cycles_to_ns (user_cycles) / 1000000);
+
+  if (cpu_cnt > 1)
+    {
+      int i;
+
+      for (i = 0; i < cpu_cnt; i++)
+        {
+          struct cpu *c = &cpus[i];
+          if (c->online)
+            printf ("CPU %d: %"PRId64" ms idle, %u steals\n",
+                    c->id, timer_cycles_to_ns (c->idle_cycles) / 1000000,
+                    c->steals);
+        }
+    }
+
+  if (rt_releases > 0)
+    printf ("Real-time: %u jobs, %u missed deadlines, %u overruns, "
+            "%"PRId64" us avg jitter, %"PRId64" us max jitter\n",
+            rt_releases, rt_missed, rt_overruns,
+            rt_jitter_ns / rt_releases / 1000, rt_jitter_max_ns / 1000);
+
+  printf ("Thread: %u context switches (%u blocked, %u yielded, "
+          "%u preempted)\n",
+          switches_blocked + switches_yielded + switches_preempted,
+          switches_blocked, switches_yielded, switches_preempted);
+
+  if (thread_stats_table)
+    print_stats_table ();
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -195,14 +526,16 @@ thread_create (const char *name, int priority,
 
   ASSERT (function != NULL);
 
-  /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  /* Allocate thread.  init_thread() clears the thread structure,
+     and the stack does not need to be zeroed. */
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  t->cpu = cpu_pick ();
 
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack'
@@ -237,6 +570,114 @@ thread_create (const char *name, int priority,
   return tid;
 }
 
+/* Body of a periodic thread: runs a job each period. */
+static void
+periodic_thread (void *rt_)
+{
+  struct rt_thread *rt = rt_;
+  struct thread *cur = thread_current ();
+
+  intr_disable ();
+  rt->release = timer_ticks ();
+  rt->deadline = rt->release + rt->period;
+  rt->release_ns = 0;
+  rt_releases++;
+  cur->rt = rt;
+  intr_enable ();
+
+  for (;;)
+    {
+      rt->function (rt->aux);
+
+      /* Wait for the next period. */
+      intr_disable ();
+      rt->done = true;
+      if (timer_ticks () > rt->deadline)
+        rt_missed++;
+      timer_add (&rt->timer, rt->release + rt->period, rt_release, cur);
+      thread_block ();
+      intr_enable ();
+    }
+}
+
+/* Creates a periodic real-time kernel thread named NAME, which
+   calls FUNCTION, passing AUX, once every PERIOD timer ticks,
+   starting now.  Each call may use up to BUDGET ticks of CPU
+   time.  Periodic threads take precedence over all other
+   threads and are scheduled earliest deadline first.  FUNCTION
+   may call thread_exit() to end the thread.
+
+   Returns the new thread's identifier, or TID_ERROR if creation
+   fails or if admitting the thread would commit more than
+   RT_UTIL_MAX of the CPU to periodic threads. */
+tid_t
+thread_create_periodic (const char *name, int64_t period, int64_t budget,
+                        thread_func *function, void *aux)
+{
+  struct rt_thread *rt;
+  enum intr_level old_level;
+  bool admitted;
+  tid_t tid;
+
+  ASSERT (function != NULL);
+  ASSERT (period > 0);
+  ASSERT (budget > 0 && budget <= period);
+
+  rt = malloc (sizeof *rt);
+  if (rt == NULL)
+    return TID_ERROR;
+  memset (rt, 0, sizeof *rt);
+  rt->function = function;
+  rt->aux = aux;
+  rt->period = period;
+  rt->budget = budget;
+  rt->utilization = DIV_ROUND_UP (budget * 1000, period);
+
+  old_level = intr_disable ();
+  admitted = rt_utilization + rt->utilization <= RT_UTIL_MAX;
+  if (admitted)
+    rt_utilization += rt->utilization;
+  intr_set_level (old_level);
+  if (!admitted)
+    {
+      free (rt);
+      return TID_ERROR;
+    }
+
+  tid = thread_create (name, PRI_MAX, periodic_thread, rt);
+  if (tid == TID_ERROR)
+    {
+      old_level = intr_disable ();
+      rt_utilization -= rt->utilization;
+      intr_set_level (old_level);
+      free (rt);
+    }
+  return tid;
+}
+
+/* Timer function that releases the next job of periodic thread
+   T, which is blocked, and preempts the running thread if T's
+   deadline comes first. */
+static void
+rt_release (void *t_)
+{
+  struct thread *t = t_;
+  struct rt_thread *rt = t->rt;
+
+  if (!rt->done)
+    rt_missed++;
+  rt->release += rt->period;
+  rt->deadline = rt->release + rt->period;
+  rt->used = 0;
+  rt->done = false;
+  rt->release_ns = timer_ns ();
+  rt_releases++;
+
+  thread_unblock (t);
+  if (ready_queue_preempts (t->cpu, thread_current ()))
+    intr_yield_on_return ();
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
@@ -250,6 +691,8 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  trace_event (TRACE_BLOCK, thread_current ()->priority,
+               thread_current ()->tid, 0);
   schedule ();
 }
 
@@ -265,14 +708,25 @@ void
 thread_unblock (struct thread *t)
 {
   enum intr_level old_level;
+  uint64_t now;
 
   ASSERT (is_thread (t));
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-	list_push_back (&ready_list, &t->elem);
+  if (thread_mlfqs)
+    {
+      mlfqs_catch_up (t);
+      t->priority = mlfqs_priority (t);
+    }
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  now = timer_cycles ();
+  t->blocked_cycles += now - t->state_start;
+  t->state_start = now;
+  trace_event (TRACE_WAKEUP, t->priority, t->tid, running_thread ()->tid);
   t->waiting = NULL;
+  t->waiting_rw = NULL;
   intr_set_level (old_level);
 }
 
@@ -320,6 +774,35 @@ thread_exit (void)
   process_exit ();
 #endif
 
+  /* Give up a periodic thread's share of the CPU. */
+  if (thread_current ()->rt != NULL)
+    {
+      struct rt_thread *rt = thread_current ()->rt;
+
+      intr_disable ();
+      thread_current ()->rt = NULL;
+      rt_utilization -= rt->utilization;
+      intr_enable ();
+      free (rt);
+    }
+
+  fpu_exit ();
+
+  /* Keep our accounting for the table. */
+  if (thread_stats_table)
+    {
+      struct exited_thread *x = malloc (sizeof *x);
+      if (x != NULL)
+        {
+          x->tid = thread_current ()->tid;
+          strlcpy (x->name, thread_current ()->name, sizeof x->name);
+          thread_get_stats (thread_current (), &x->stats);
+          intr_disable ();
+          list_push_back (&exited_list, &x->elem);
+          intr_enable ();
+        }
+    }
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
@@ -334,6 +817,44 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void)
+{
+  yield (false);
+}
+
+/* Yields the CPU because a thread in the run queue should run
+   instead of the current one.  Unlike thread_yield(), the switch
+   is counted as a preemption. */
+void
+thread_preempt (void)
+{
+  yield (true);
+}
+
+/* Preempts the running thread if a thread in its CPU's run queue
+   should run instead.  In an interrupt handler, the preemption
+   happens just before the interrupt returns.  Otherwise it
+   happens right away, and if no such thread is ready this
+   returns without switching. */
+void
+thread_preempt_if_needed (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool preempt = ready_queue_preempts (cpu_current (), thread_current ());
+  intr_set_level (old_level);
+
+  if (!preempt)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_preempt ();
+}
+
+/* Puts the current thread back in the run queue and schedules
+   another thread.  PREEMPTED says whether the thread gives way
+   to a more urgent one rather than yielding of its own accord. */
+static void
+yield (bool preempted)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
@@ -341,10 +862,25 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) {
-		list_push_back (&ready_list, &cur->elem);
-	}
+  if (cur->rt != NULL && cur->rt->used >= cur->rt->budget)
+    {
+      /* Out of budget: sit out the rest of the period. */
+      rt_overruns++;
+      timer_add (&cur->rt->timer, cur->rt->release + cur->rt->period,
+                 rt_release, cur);
+      cur->status = THREAD_BLOCKED;
+      schedule ();
+      intr_set_level (old_level);
+      return;
+    }
+  if (cur != cur->cpu->idle_thread)
+    {
+      if (thread_mlfqs)
+        cur->priority = mlfqs_priority (cur);
+      ready_queue_push (cur);
+    }
   cur->status = THREAD_READY;
+  cur->cpu->preempting = preempted;
   schedule ();
   intr_set_level (old_level);
 }
@@ -366,173 +902,726 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Setup the priority of the thread by getting highest donated value. */
-void
-setup_priority_donation (struct thread *t)
-{
-  /* No priority donation in advanced schedular */
-  if (thread_mlfqs)
-    return;
+/* Priority donation.
 
-	struct list_elem *e1;
-	struct list_elem *e2;
-	int max_priority = t->original_priority;
-
-  /* loops over the list of locks aquired by this thread. */
-	for (e1 = list_begin (&t->locks); e1 != list_end (&t->locks); e1 = list_next (e1))
-	{
-		struct lock *l = list_entry (e1, struct lock, elem);
-		struct semaphore *s = &l->semaphore;
-    /* loops over the list of threads waiting on the current lock held by this thread. */
-		for (e2 = list_begin (&s->waiters); e2 != list_end (&s->waiters); e2 = list_next (e2))
-		{
-			struct thread *thread = list_entry (e2, struct thread, elem);
-			max_priority = max_priority > thread->priority ? max_priority : thread->priority;
-		}
-	}
-  int old_priority = t->priority;
-  t->priority = max_priority;
-  /* If this thread is waiting for another lock, then recurse on this thread to setup its donated priority.
-     This achieves nested donation. */
-  if (t->waiting != NULL){
-    setup_priority_donation (t->waiting->holder);
-  }
-  /* Yield if new priority is less than old priority. */
-  if (t->priority < old_priority)
-    thread_yield ();
-}
+   Each lock caches in its donor the highest priority of the
+   threads waiting on it.  Each thread keeps the donors of the
+   locks it holds that have waiters in `donors', a leftist
+   max-heap keyed on priority, so the highest donation it receives
+   is always at the root.  Inserting or removing a donor, or
+   changing its key, takes O(log n) time in the number of locks
+   held.
 
-/* Sets the current thread's priority to new_priority. */
-void
-thread_set_priority (int new_priority)
-{
-  /* Advanced schedular only sets the priority and does nothing else. */
-  if (thread_mlfqs)
-  {
-    thread_current ()->priority = new_priority;
-    return;
-  }
-  /* Update the original priority and sets up the donation. */
-  thread_current ()->original_priority = new_priority;
-  enum intr_level old_level;
-  old_level = intr_disable ();
-  setup_priority_donation (thread_current());
-  intr_set_level (old_level);
+   A readers-writer lock has one donor for its writer, and one
+   more per reader in the reader's rw_hold, so that a waiter
+   donates to every thread that holds the lock.
 
-  /* Yield if the current thread no longer has the highest priority. */
-  if (!list_empty(&ready_list)){
-		struct list_elem *max = list_max (&ready_list, priority_thread_less, NULL);
-    struct thread *t = list_entry (max, struct thread, elem);
-    if (t->priority > new_priority)
-      thread_yield();
-  }
+   When a thread starts to wait on a lock, its priority is pushed
+   up the chain of lock holders one hop at a time.  Propagation
+   stops as soon as a hop leaves a holder's priority unchanged, or
+   after thread_donation_depth hops. */
+
+/* Returns the rank of donor heap node D. */
+static int
+donor_rank (const struct donor *d)
+{
+  return d != NULL ? d->rank : 0;
 }
 
-/* Returns the length of the ready queue. */
-int
-ready_queue_length(void)
+/* Merges donor heaps A and B and returns the new root. */
+static struct donor *
+donor_merge (struct donor *a, struct donor *b)
 {
-	return list_size(&ready_list);
+  struct donor *tmp;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (b->priority > a->priority)
+    {
+      tmp = a;
+      a = b;
+      b = tmp;
+    }
+
+  a->right = donor_merge (a->right, b);
+  a->right->parent = a;
+  if (donor_rank (a->left) < donor_rank (a->right))
+    {
+      tmp = a->left;
+      a->left = a->right;
+      a->right = tmp;
+    }
+  a->rank = donor_rank (a->right) + 1;
+  return a;
 }
 
-/* Returns the current thread's priority. */
-int
-thread_get_priority (void)
+/* Adds donor D to T's donor heap. */
+static void
+donor_insert (struct thread *t, struct donor *d)
 {
-  return thread_current ()->priority;
+  ASSERT (d->rank == 0);
+
+  d->parent = d->left = d->right = NULL;
+  d->rank = 1;
+  t->donors = donor_merge (t->donors, d);
+  t->donors->parent = NULL;
 }
 
-/* Sets the current thread's nice value and recalculates the thread's priority based on the new value.
-   priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
-void
-thread_set_nice (int nice)
+/* Removes donor D from T's donor heap. */
+static void
+donor_remove (struct thread *t, struct donor *d)
 {
-  thread_current()->nice = nice;
-	struct float32 real = to_float(thread_get_recent_cpu());
-	struct float32 real4 = to_float(4);
-	real = divide(real, real4);
-	int calc_p = to_int(multiply_int((subtract_int(add_int(real, nice * 2), PRI_MAX)), -1), false);
-  thread_set_priority (calc_p);
-	thread_yield ();
+  struct donor *parent = d->parent;
+  struct donor *sub = donor_merge (d->left, d->right);
+
+  ASSERT (d->rank > 0);
+
+  if (sub != NULL)
+    sub->parent = parent;
+  if (parent == NULL)
+    t->donors = sub;
+  else
+    {
+      if (parent->left == d)
+        parent->left = sub;
+      else
+        parent->right = sub;
+
+      /* Restore the leftist property on the path to the root,
+         stopping once a rank comes out unchanged. */
+      for (; parent != NULL; parent = parent->parent)
+        {
+          int rank;
+
+          if (donor_rank (parent->left) < donor_rank (parent->right))
+            {
+              struct donor *tmp = parent->left;
+              parent->left = parent->right;
+              parent->right = tmp;
+            }
+          rank = donor_rank (parent->right) + 1;
+          if (rank == parent->rank)
+            break;
+          parent->rank = rank;
+        }
+    }
+  d->parent = d->left = d->right = NULL;
+  d->rank = 0;
 }
 
-/* Returns the current thread's nice value. */
-int
-thread_get_nice (void)
+/* Starts or stops timing T's donation, as DONATED says whether
+   T's priority is now raised by a donation. */
+static void
+donation_account (struct thread *t, bool donated)
 {
-  return thread_current()->nice;
+  if (donated && t->donated_start == 0)
+    t->donated_start = timer_cycles ();
+  else if (!donated && t->donated_start != 0)
+    {
+      t->donated_cycles += timer_cycles () - t->donated_start;
+      t->donated_start = 0;
+    }
 }
 
-/* Set load_avg of the CPU. */
-void
-thread_set_load_avg (struct float32 value)
+/* Sets T's priority to the larger of its own priority and the
+   highest priority donated to it.  Returns true if T's priority
+   changed. */
+static bool
+thread_recompute_priority (struct thread *t)
 {
-	load_avg.n = value.n;
+  int priority = t->original_priority;
+
+  if (t->donors != NULL && t->donors->priority > priority)
+    priority = t->donors->priority;
+  donation_account (t, priority > t->original_priority);
+  if (priority == t->priority)
+    return false;
+  thread_update_priority (t, priority);
+  return true;
 }
 
-/* Returns 100 times the system load average rounded to the nearest integer. */
-int
-thread_get_load_avg (void)
+/* Donates PRIORITY to HOLDER through its donor D.  Returns true
+   if HOLDER's priority went up as a result. */
+static bool
+donate (struct thread *holder, struct donor *d, int priority)
 {
-  return to_int (multiply_int (load_avg, 100), true);
+  if (priority <= d->priority)
+    return false;
+
+  d->priority = priority;
+  if (d->rank > 0)
+    donor_remove (holder, d);
+  donor_insert (holder, d);
+  trace_event (TRACE_DONATE, priority, holder->tid, running_thread ()->tid);
+  return thread_recompute_priority (holder);
 }
 
-struct float32
-thread_get_real_load_avg (void)
+/* Pushes T's priority along the chain of locks that T is waiting
+   on, taking at most thread_donation_depth hops from DEPTH. */
+static void
+donate_chain (struct thread *t, int depth)
 {
-  return load_avg;
+  for (; depth < thread_donation_depth; depth++)
+    {
+      struct thread *holder;
+      struct donor *d;
+
+      if (t->waiting != NULL)
+        {
+          holder = t->waiting->holder;
+          d = &t->waiting->donor;
+        }
+      else if (t->waiting_rw != NULL && t->waiting_rw->writer != NULL)
+        {
+          holder = t->waiting_rw->writer;
+          d = &t->waiting_rw->donor;
+        }
+      else if (t->waiting_rw != NULL)
+        {
+          /* Held for reading: donate to each reader in turn. */
+          struct list *readers = &t->waiting_rw->readers;
+          struct list_elem *e;
+
+          for (e = list_begin (readers); e != list_end (readers);
+               e = list_next (e))
+            {
+              struct rw_hold *h = list_entry (e, struct rw_hold, elem);
+              if (donate (h->thread, &h->donor, t->priority))
+                donate_chain (h->thread, depth + 1);
+            }
+          break;
+        }
+      else
+        break;
+
+      if (holder == NULL || !donate (holder, d, t->priority))
+        break;
+      t = holder;
+    }
 }
 
-/* Set recent_cpu time. */
+/* Donates T's priority along the chain of locks that T is
+   waiting on.  Interrupts must be off. */
 void
-thread_set_recent_cpu (int value)
+thread_donate_priority (struct thread *t)
 {
-	thread_current ()->recent_cpu = value;
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* No priority donation in advanced schedular */
+  if (thread_mlfqs)
+    return;
+
+  donate_chain (t, 0);
 }
 
-/* Returns 100 times the current thread's recent_cpu value rounded to the nearest integer. */
-int
-thread_get_recent_cpu (void)
+/* Returns the priority of the first thread in WAITERS, which is
+   ordered by priority, or PRI_MIN - 1 if WAITERS is empty. */
+static int
+waiter_priority (struct heap *waiters)
 {
-  struct float32 real = to_float(thread_current ()->recent_cpu);
-  return to_int (multiply_int (real, 100), true);
+  if (heap_empty (waiters))
+    return PRI_MIN - 1;
+  return heap_entry (heap_min (waiters), struct thread, heap_elem)->priority;
 }
-
-/* Idle thread.  Executes when no other thread is ready to run.
+
+/* Makes T, which has just acquired a lock, receive PRIORITY
+   through the lock's donor D, unless PRIORITY is below PRI_MIN
+   because no one is waiting. */
+static void
+donor_take_over (struct thread *t, struct donor *d, int priority)
+{
+  ASSERT (d->rank == 0);
+
+  if (thread_mlfqs || priority < PRI_MIN)
+    return;
+
+  d->priority = priority;
+  donor_insert (t, d);
+  thread_recompute_priority (t);
+}
+
+/* Stops T from receiving donations through its donor D. */
+static void
+donor_drop (struct thread *t, struct donor *d)
+{
+  if (d->rank > 0)
+    {
+      donor_remove (t, d);
+      thread_recompute_priority (t);
+    }
+  d->priority = PRI_MIN - 1;
+}
+
+/* Records that the running thread has just acquired LOCK, taking
+   over donations from the threads still waiting on it.
+   Interrupts must be off. */
+void
+thread_lock_acquired (struct lock *lock)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (lock->holder == thread_current ());
+
+  donor_take_over (lock->holder, &lock->donor,
+                   waiter_priority (&lock->semaphore.waiters));
+}
+
+/* Records that the running thread is about to release LOCK and
+   drops the donations it received through it.  Interrupts must
+   be off. */
+void
+thread_lock_released (struct lock *lock)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (lock->holder == thread_current ());
+
+  donor_drop (lock->holder, &lock->donor);
+}
+
+/* Records that T has just been given RW, for writing if T is
+   RW's writer and otherwise for reading, and makes T receive
+   donations from the threads still waiting on RW.  Interrupts
+   must be off. */
+void
+thread_rwlock_acquired (struct rwlock *rw, struct thread *t)
+{
+  struct donor *d;
+  int read_priority, write_priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (rw->writer == t)
+    d = &rw->donor;
+  else
+    {
+      struct rw_hold *h = NULL;
+      int i;
+
+      for (i = 0; i < RW_READ_MAX; i++)
+        {
+          ASSERT (t->read_holds[i].rwlock != rw);
+          if (h == NULL && t->read_holds[i].rwlock == NULL)
+            h = &t->read_holds[i];
+        }
+      if (h == NULL)
+        PANIC ("thread %s holds too many rwlocks for reading", t->name);
+
+      h->rwlock = rw;
+      h->thread = t;
+      h->donor.priority = PRI_MIN - 1;
+      list_push_back (&rw->readers, &h->elem);
+      d = &h->donor;
+    }
+
+  read_priority = waiter_priority (&rw->read_waiters);
+  write_priority = waiter_priority (&rw->write_waiters);
+  donor_take_over (t, d, read_priority > write_priority
+                         ? read_priority : write_priority);
+}
+
+/* Records that the running thread is about to release RW, and
+   drops the donations it received through it.  Interrupts must
+   be off. */
+void
+thread_rwlock_released (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (rw->writer == cur)
+    {
+      donor_drop (cur, &rw->donor);
+      return;
+    }
+
+  for (i = 0; i < RW_READ_MAX; i++)
+    if (cur->read_holds[i].rwlock == rw)
+      {
+        struct rw_hold *h = &cur->read_holds[i];
+
+        donor_drop (cur, &h->donor);
+        list_remove (&h->elem);
+        h->rwlock = NULL;
+        return;
+      }
+  NOT_REACHED ();
+}
+
+/* Sets the current thread's priority to new_priority. */
+void
+thread_set_priority (int new_priority)
+{
+  /* Advanced schedular only sets the priority and does nothing else. */
+  if (thread_mlfqs)
+  {
+    enum intr_level old_level = intr_disable ();
+    thread_update_priority (thread_current (), new_priority);
+    intr_set_level (old_level);
+    return;
+  }
+  /* Update the original priority and reapply donations. */
+  thread_current ()->original_priority = new_priority;
+  enum intr_level old_level;
+  old_level = intr_disable ();
+  thread_recompute_priority (thread_current ());
+  intr_set_level (old_level);
+
+  /* Yield if the current thread should no longer run. */
+  if (ready_queue_preempts (cpu_current (), thread_current ()))
+    thread_preempt ();
+}
+
+/* Makes the running thread keep the priority it was created
+   with, even under the MLFQS, which otherwise recomputes every
+   thread's priority from its recent_cpu and nice value.  For
+   kernel threads such as work queue workers whose priority must
+   not decay.  Their CPU time still counts toward load_avg. */
+void
+thread_fix_priority (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  cur->fixed_priority = true;
+  if (thread_mlfqs)
+    thread_update_priority (cur, cur->original_priority);
+  intr_set_level (old_level);
+}
+
+/* Sets T's effective priority to PRIORITY.  If T is on the ready
+   queue, it is moved to the back of the list for its new
+   priority so that it is picked according to the new value.  If
+   T is waiting on a semaphore or condition variable, it keeps
+   its place in line among waiters of its new priority.
+   Interrupts must be off. */
+void
+thread_update_priority (struct thread *t, int priority)
+{
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  if (t->priority == priority)
+    return;
+  if (t->status == THREAD_READY && t != t->cpu->idle_thread)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    t->priority = priority;
+  synch_requeue (t);
+}
+
+/* Returns the number of ready threads, summed over all CPUs. */
+int
+ready_queue_length(void)
+{
+  int cnt = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    cnt += cpus[i].ready_cnt;
+  return cnt;
+}
+
+/* Returns the current thread's priority. */
+int
+thread_get_priority (void)
+{
+  return thread_current ()->priority;
+}
+
+/* Sets the current thread's nice value and recalculates the thread's priority based on the new value.
+   priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
+void
+thread_set_nice (int nice)
+{
+  struct thread *cur = thread_current ();
+
+  cur->nice = nice;
+  thread_set_priority (mlfqs_priority (cur));
+	thread_yield ();
+}
+
+/* Returns the current thread's nice value. */
+int
+thread_get_nice (void)
+{
+  return thread_current()->nice;
+}
+
+/* Returns 100 times the system load average rounded to the nearest integer. */
+int
+thread_get_load_avg (void)
+{
+  return to_int (multiply_int (load_avg, 100), true);
+}
+
+/* Set recent_cpu time. */
+void
+thread_set_recent_cpu (int value)
+{
+	thread_current ()->recent_cpu = value;
+}
+
+/* Returns 100 times the current thread's recent_cpu value rounded to the nearest integer. */
+int
+thread_get_recent_cpu (void)
+{
+  struct float64 real = to_float(thread_current ()->recent_cpu);
+  return to_int (multiply_int (real, 100), true);
+}
+
+/* Returns the MLFQS priority for T according to this formula,
+   clamped to PRI_MIN...PRI_MAX:
+   priority = PRI_MAX - (recent_cpu / 4) - (nice * 2)
+   A thread that has called thread_fix_priority() keeps the
+   priority it was created with instead. */
+static int
+mlfqs_priority (struct thread *t)
+{
+  struct float64 real;
+  int priority;
+
+  if (t->fixed_priority)
+    return t->original_priority;
+
+  real = divide_int (to_float (t->recent_cpu), 4);
+  priority = to_int (multiply_int (subtract_int (add_int (real, t->nice * 2),
+                                                 PRI_MAX), -1), false);
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  else
+    return priority;
+}
+
+/* Applies to T's recent_cpu the decays it has missed, according
+   to this formula for each:
+   recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice
+
+   The result is exact if T missed at most DECAY_HISTORY decays.
+   Otherwise it is approximate, because decay_history keeps only
+   the coefficients of the last DECAY_HISTORY.  The older decays
+   are replayed with the oldest coefficient kept, as if load_avg
+   had held steady before the window.  This stops after
+   DECAY_HISTORY rounds, or earlier if recent_cpu stops changing.
+   The decays in the window are then replayed exactly.  That
+   scales the error from before the window down by the product of
+   the window's coefficients, which is at most
+   (2L/(2L+1))**DECAY_HISTORY for the highest load_avg L in the
+   window.  The factor is under 0.0001 for L up to 3, about 0.04
+   at L = 10, and about 0.6 at L = 60.
+
+   Interrupts must be off. */
+static void
+mlfqs_catch_up (struct thread *t)
+{
+  int64_t missed = decay_epoch - t->decay_epoch;
+  int64_t epoch;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (missed > DECAY_HISTORY)
+    {
+      struct float64 coef = decay_history[decay_epoch % DECAY_HISTORY];
+      int i;
+
+      for (i = 0; i < DECAY_HISTORY; i++)
+        {
+          int old = t->recent_cpu;
+          t->recent_cpu = to_int (add_int (multiply_int (coef, t->recent_cpu),
+                                           t->nice), true);
+          if (t->recent_cpu == old)
+            break;
+        }
+      missed = DECAY_HISTORY;
+    }
+
+  for (epoch = decay_epoch - missed; epoch < decay_epoch; epoch++)
+    {
+      struct float64 coef = decay_history[epoch % DECAY_HISTORY];
+      t->recent_cpu = to_int (add_int (multiply_int (coef, t->recent_cpu),
+                                       t->nice), true);
+    }
+  t->decay_epoch = decay_epoch;
+}
+
+/* Brings the ready threads on CPU C up to date after a decay,
+   moving each one to the back of the ready list for its new
+   priority.  Takes C's run queue lock for at most
+   thread_decay_batch threads at a time, so that interrupts are
+   not kept off for longer as more threads are ready.
+
+   A thread is up to date once its decay_epoch is current.
+   Everything else that adds a thread to a ready list brings it
+   up to date first, so the threads still to do are at the front
+   of each list and the rest can be skipped. */
+static void
+mlfqs_decay_cpu (struct cpu *c)
+{
+  int priority = PRI_MAX;
+
+  while (priority >= PRI_MIN)
+    {
+      int cnt = 0;
+
+      spinlock_acquire (&c->rq_lock);
+      while (priority >= PRI_MIN && cnt < thread_decay_batch)
+        {
+          struct list *list = &c->ready_lists[priority];
+          struct thread *t;
+
+          if (list_empty (list))
+            {
+              priority--;
+              continue;
+            }
+          t = list_entry (list_front (list), struct thread, elem);
+          if (t->decay_epoch == decay_epoch)
+            {
+              priority--;
+              continue;
+            }
+
+          /* Periodic threads are kept in rt_heap, not here, so
+             ready_cnt does not change. */
+          sched->dequeue (c, t);
+          mlfqs_catch_up (t);
+          t->priority = mlfqs_priority (t);
+          sched->enqueue (c, t);
+          cnt++;
+        }
+      spinlock_release (&c->rq_lock);
+    }
+}
+
+/* Decays the ready threads on every CPU.  Runs in a work queue
+   on behalf of thread_mlfqs_tick(). */
+static void
+mlfqs_decay (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].online)
+      mlfqs_decay_cpu (&cpus[i]);
+}
+
+/* Does the MLFQS work for a timer tick.  Called by the timer
+   interrupt handler at each timer tick, including ticks skipped
+   in tickless idle, with interrupts off.  Only the running thread
+   is touched, so that the cost does not depend on the number of
+   threads.  The once a second decay of the ready threads, which
+   does, is left to the high-priority work queue, and a thread
+   that runs before the decay reaches it catches up as it is
+   scheduled. */
+void
+thread_mlfqs_tick (int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_context ());
+
+  if (ticks % TIMER_FREQ == 0)
+    {
+      struct float64 real;
+      int ready_threads;
+      int i;
+
+      /* Calculates load_avg according to this formula:
+         load_avg = (59/60)*load_avg + (1/60)*ready_threads */
+      ready_threads = ready_queue_length ();
+      for (i = 0; i < cpu_cnt; i++)
+        if (cpu_busy (&cpus[i]))
+          ready_threads++;
+      load_avg = add (multiply (divide (to_float (59), to_float (60)),
+                                load_avg),
+                      multiply_int (divide (to_float (1), to_float (60)),
+                                    ready_threads));
+
+      /* Record the decay coefficient for this second. */
+      real = multiply_int (load_avg, 2);
+      decay_history[decay_epoch++ % DECAY_HISTORY]
+        = divide (real, add_int (real, 1));
+
+      /* The work queues are created just after interrupts go on
+         at boot.  A decay missed before then is made up by the
+         next one, since each thread catches up on every decay it
+         has missed. */
+      mlfqs_catch_up (cur);
+      if (system_highpri_wq != NULL)
+        work_queue (system_highpri_wq, &decay_work);
+    }
+
+  if (ticks % 4 == 0)
+    {
+      if (!is_idle_thread (cur))
+        thread_update_priority (cur, mlfqs_priority (cur));
+      intr_yield_on_return ();
+    }
+}
+
+/* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
+   point it initializes its CPU's idle_thread, "up"s the
+   semaphore passed
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   special case when the ready list is empty.  Each time it runs,
+   it tops up the page allocator's stock of zeroed pages before
+   halting the CPU.  The application processors' idle threads are
+   made by thread_start_ap() instead. */
 static void
 idle (void *idle_started_ UNUSED)
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  thread_current ()->cpu->idle_thread = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Body of every CPU's idle thread. */
+static void
+idle_loop (void)
+{
   for (;;)
     {
-      /* Let someone else run. */
+      /* Let someone else run, resuming the periodic timer tick
+         first if it was stopped for tickless idle. */
       intr_disable ();
+      timer_idle_exit ();
       thread_block ();
 
-      /* Re-enable interrupts and wait for the next one.
-
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
-
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+      /* Zero a page for the page allocator, if it wants one,
+         with interrupts on.  Then go around again, so that a
+         thread woken meanwhile runs before any more zeroing.
+         The idle thread never counts toward load_avg and never
+         competes with other threads, so the zeroing only uses
+         time that would otherwise be spent halted. */
+      if (palloc_zero_wanted ())
+        {
+          intr_enable ();
+          palloc_zero_idle ();
+          continue;
+        }
+
+      /* Re-enable interrupts and wait for the next one. */
+      intr_wait ();
     }
 }
 
@@ -568,10 +1657,11 @@ is_thread (struct thread *t)
   return t != NULL && t->magic == THREAD_MAGIC;
 }
 
+/* Returns true if T is the idle thread of its CPU. */
 bool
 is_idle_thread(struct thread *t)
 {
-  return t == idle_thread;
+  return t == t->cpu->idle_thread;
 }
 
 /* Does basic initialization of T as a blocked thread named
@@ -579,6 +1669,8 @@ is_idle_thread(struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -591,9 +1683,15 @@ init_thread (struct thread *t, const char *name, int priority)
   t->original_priority = priority;
   t->recent_cpu = 0;
   t->waiting = NULL;
+  t->donors = NULL;
+  t->cpu = &cpus[0];
+  t->state_start = timer_cycles ();
+  t->decay_epoch = decay_epoch;
   t->magic = THREAD_MAGIC;
-  list_init (&t->locks);
+
+  old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -609,22 +1707,361 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled having max priority.
-   Should return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Chooses and returns the next thread to be scheduled on CPU C,
+   as picked by the scheduling class.  Should return a thread from C's
+   run queue, unless the run queue is empty.  (If the running
+   thread can continue running, then it will be in the run
+   queue.)  If the run queue is empty, tries to steal a thread
+   from another CPU, and failing that returns C's idle thread. */
+static struct thread *
+next_thread_to_run (struct cpu *c)
+{
+  struct thread *t;
+
+  spinlock_acquire (&c->rq_lock);
+  t = ready_queue_pick (c);
+  if (t != NULL)
+    ready_queue_delete (c, t);
+  spinlock_release (&c->rq_lock);
+  if (t == NULL)
+    t = ready_queue_steal (c);
+  return t != NULL ? t : c->idle_thread;
+}
+
+/* Initializes CPU C's run queue as empty. */
+static void
+ready_queue_init (struct cpu *c)
+{
+  int i;
+
+  spinlock_init (&c->rq_lock);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&c->ready_lists[i]);
+  c->ready_bitmap = 0;
+  heap_init (&c->stride_heap, stride_less, NULL);
+  c->stride_vtime = 0;
+  heap_init (&c->rt_heap, rt_less, NULL);
+  c->ready_cnt = 0;
+}
+
+/* Adds T to CPU C's run queue, whose lock must be held. */
+static void
+ready_queue_insert (struct cpu *c, struct thread *t)
+{
+  if (t->rt != NULL)
+    heap_insert (&c->rt_heap, &t->heap_elem);
+  else
+    sched->enqueue (c, t);
+  c->ready_cnt++;
+}
+
+/* Removes T from CPU C's run queue, whose lock must be held. */
+static void
+ready_queue_delete (struct cpu *c, struct thread *t)
+{
+  if (t->rt != NULL)
+    heap_remove (&c->rt_heap, &t->heap_elem);
+  else
+    sched->dequeue (c, t);
+  c->ready_cnt--;
+  ASSERT (c->ready_cnt >= 0);
+}
+
+/* Returns the thread in CPU C's run queue that should run next,
+   without removing it, or a null pointer if the queue is empty.
+   C's run queue lock must be held. */
+static struct thread *
+ready_queue_pick (struct cpu *c)
+{
+  if (!heap_empty (&c->rt_heap))
+    return heap_entry (heap_min (&c->rt_heap), struct thread, heap_elem);
+  return sched->pick (c);
+}
+
+/* Takes the thread that the busiest other CPU would run next out
+   of its run queue, for CPU C to run, and returns it.  Returns a
+   null pointer if no other CPU has a ready thread, if the busiest
+   one's run queue lock is taken, or if its next thread must stay
+   where it is: a periodic real-time thread, which was admitted on
+   its CPU, or the thread whose state is still in that CPU's FPU.
+   schedule() moves the thread to C.
+
+   An idle CPU comes back here after every interrupt, including
+   its own timer tick, so this also serves as the periodic
+   rebalancing pass. */
+static struct thread *
+ready_queue_steal (struct cpu *c)
+{
+  struct cpu *victim = NULL;
+  struct thread *t;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *p = &cpus[i];
+      if (p != c && p->online && p->ready_cnt > 0
+          && (victim == NULL || p->ready_cnt > victim->ready_cnt))
+        victim = p;
+    }
+  if (victim == NULL || !spinlock_try_acquire (&victim->rq_lock))
+    return NULL;
+
+  t = ready_queue_pick (victim);
+  if (t != NULL && t->rt == NULL && t != victim->fpu_owner)
+    {
+      ready_queue_delete (victim, t);
+      c->steals++;
+    }
+  else
+    t = NULL;
+  spinlock_release (&victim->rq_lock);
+  return t;
+}
+
+/* Returns true if a thread in CPU C's run queue should run
+   instead of T.  Takes C's run queue lock, which must not already
+   be held. */
+static bool
+ready_queue_preempts (struct cpu *c, struct thread *t)
+{
+  bool preempts;
+
+  spinlock_acquire (&c->rq_lock);
+  if (!heap_empty (&c->rt_heap))
+    {
+      struct thread *first = heap_entry (heap_min (&c->rt_heap),
+                                         struct thread, heap_elem);
+      preempts = t->rt == NULL || first->rt->deadline < t->rt->deadline;
+    }
+  else
+    preempts = t->rt == NULL && sched->preempts (c, t);
+  spinlock_release (&c->rq_lock);
+  return preempts;
+}
+
+/* Adds T to its CPU's run queue.  If that is another CPU, kicks
+   it, so that T can preempt the thread running there. */
+static void
+ready_queue_push (struct thread *t)
+{
+  struct cpu *c = t->cpu;
+
+  spinlock_acquire (&c->rq_lock);
+  ready_queue_insert (c, t);
+  if (c != running_thread ()->cpu)
+    cpu_kick (c);
+  spinlock_release (&c->rq_lock);
+}
+
+/* Removes T from its CPU's run queue. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  struct cpu *c = t->cpu;
+
+  spinlock_acquire (&c->rq_lock);
+  ready_queue_delete (c, t);
+  spinlock_release (&c->rq_lock);
+}
+
+/* Returns the highest priority of any ready thread on CPU C, or
+   -1 if its run queue is empty.  The bitmap is split into 32-bit
+   halves so that each half is a single BSR instruction. */
+static int
+ready_queue_max_priority (struct cpu *c)
+{
+  uint64_t bitmap = c->ready_bitmap;
+  uint32_t high = bitmap >> 32;
+  uint32_t low = bitmap;
+
+  if (high != 0)
+    return 63 - __builtin_clz (high);
+  else if (low != 0)
+    return 31 - __builtin_clz (low);
+  else
+    return -1;
+}
+
+/* Chooses the CPU for a new thread: the online CPU with the
+   fewest threads running or ready, preferring the current one. */
+static struct cpu *
+cpu_pick (void)
+{
+  struct cpu *best = cpu_current ();
+  int best_load = best->ready_cnt + cpu_busy (best);
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *c = &cpus[i];
+      int load = c->ready_cnt + cpu_busy (c);
+      if (c->online && load < best_load)
+        {
+          best = c;
+          best_load = load;
+        }
+    }
+  return best;
+}
+
+/* Returns true if C is online and running a thread other than its
+   idle thread. */
+static bool
+cpu_busy (struct cpu *c)
+{
+  return (c->online
+          && (c->idle_thread == NULL
+              || c->idle_thread->status != THREAD_RUNNING));
+}
+
+/* Priority scheduling class: runs the highest-priority ready
+   thread, round-robin within a priority. */
+
+/* Appends T to the ready list for its priority on CPU C. */
+static void
+priority_enqueue (struct cpu *c, struct thread *t)
+{
+  list_push_back (&c->ready_lists[t->priority], &t->elem);
+  c->ready_bitmap |= (uint64_t) 1 << t->priority;
+}
+
+/* Removes T from the ready list for its priority on CPU C. */
+static void
+priority_dequeue (struct cpu *c, struct thread *t)
+{
+  list_remove (&t->elem);
+  if (list_empty (&c->ready_lists[t->priority]))
+    c->ready_bitmap &= ~((uint64_t) 1 << t->priority);
+}
+
+/* Returns the first thread on CPU C's highest-priority nonempty
+   ready list, or a null pointer if there is none. */
+static struct thread *
+priority_pick (struct cpu *c)
+{
+  int priority = ready_queue_max_priority (c);
+
+  if (priority < 0)
+    return NULL;
+  return list_entry (list_front (&c->ready_lists[priority]),
+                     struct thread, elem);
+}
+
+/* Returns true if a thread ready on CPU C has a higher priority
+   than T. */
+static bool
+priority_preempts (struct cpu *c, struct thread *t)
+{
+  return ready_queue_max_priority (c) > t->priority;
+}
+
+static const struct sched_class priority_class =
+  {
+    priority_enqueue,
+    priority_dequeue,
+    priority_pick,
+    priority_preempts,
+    NULL,
+  };
+
+/* Stride scheduling class: runs the ready thread with the lowest
+   pass value, and advances the running thread's pass by its
+   stride, inversely proportional to its tickets, at each timer
+   tick.  Over time each thread gets a share of the CPU in
+   proportion to its tickets.  See C. A. Waldspurger and W. E.
+   Weihl, "Stride Scheduling: Deterministic Proportional-Share
+   Resource Management", MIT/LCS/TM-528, 1995. */
+
+/* Returns T's stride. */
+static int64_t
+stride_of (struct thread *t)
+{
+  return STRIDE1 / (t->priority - PRI_MIN + 1);
+}
+
+/* Returns true if thread A's pass value is less than thread
+   B's. */
+static bool
+stride_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, heap_elem);
+  const struct thread *b = heap_entry (b_, struct thread, heap_elem);
+
+  return a->pass < b->pass;
+}
+
+/* Adds T to CPU C's heap.  A thread that is new or has been
+   blocked starts no earlier than the CPU's virtual time, so that
+   it does not make up for the time it was away at the expense of
+   the threads that stayed ready. */
+static void
+stride_enqueue (struct cpu *c, struct thread *t)
+{
+  if (t->pass < c->stride_vtime)
+    t->pass = c->stride_vtime;
+  heap_insert (&c->stride_heap, &t->heap_elem);
+}
+
+/* Removes T from CPU C's heap. */
+static void
+stride_dequeue (struct cpu *c, struct thread *t)
+{
+  heap_remove (&c->stride_heap, &t->heap_elem);
+}
+
+/* Returns the thread with the lowest pass value in CPU C's heap,
+   or a null pointer if it is empty, and advances C's virtual time
+   to its pass value. */
 static struct thread *
-next_thread_to_run (void)
+stride_pick (struct cpu *c)
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else {
-		struct list_elem *max = list_max (&ready_list, priority_thread_less, NULL);
-		list_remove(max);
-		return list_entry (max, struct thread, elem);
-	}
+  struct thread *t;
 
+  if (heap_empty (&c->stride_heap))
+    return NULL;
+  t = heap_entry (heap_min (&c->stride_heap), struct thread, heap_elem);
+  c->stride_vtime = t->pass;
+  return t;
+}
+
+/* Returns true if a thread ready on CPU C has a lower pass value
+   than T. */
+static bool
+stride_preempts (struct cpu *c, struct thread *t)
+{
+  struct heap *h = &c->stride_heap;
+
+  return (!heap_empty (h)
+          && heap_entry (heap_min (h), struct thread, heap_elem)->pass < t->pass);
+}
+
+/* Charges the running thread T for a timer tick. */
+static void
+stride_tick (struct thread *t)
+{
+  t->pass += stride_of (t);
+}
+
+static const struct sched_class stride_class =
+  {
+    stride_enqueue,
+    stride_dequeue,
+    stride_pick,
+    stride_preempts,
+    stride_tick,
+  };
+
+/* Returns true if periodic thread A's deadline is earlier than
+   periodic thread B's. */
+static bool
+rt_less (const struct heap_elem *a_, const struct heap_elem *b_,
+         void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, heap_elem);
+  const struct thread *b = heap_entry (b_, struct thread, heap_elem);
+
+  return a->rt->deadline < b->rt->deadline;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -654,13 +2091,31 @@ thread_schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->thread_ticks = 0;
+
+  /* Apply any decay that the ready threads are still waiting
+     for, before we start adding to recent_cpu. */
+  if (thread_mlfqs)
+    mlfqs_catch_up (cur);
+
+  /* Measure how long a newly released job waited to start. */
+  if (cur->rt != NULL && cur->rt->release_ns != 0)
+    {
+      int64_t jitter = timer_ns () - cur->rt->release_ns;
+      rt_jitter_ns += jitter;
+      if (jitter > rt_jitter_max_ns)
+        rt_jitter_max_ns = jitter;
+      cur->rt->release_ns = 0;
+    }
 
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
 #endif
 
+  /* Let the thread use the FPU freely if its state is loaded. */
+  fpu_activate (cur);
+
   /* If the thread we switched from is dying, destroy its struct
      thread.  This must happen late so that thread_exit() doesn't
      pull out the rug under itself.  (We don't free
@@ -669,10 +2124,57 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_put (cur->cpu, prev);
     }
 }
 
+/* Returns a page for a new thread, preferably one that a dead
+   thread left in the running CPU's cache, which saves going to
+   the page allocator.  The page's contents are arbitrary.
+   Returns a null pointer if no page is available. */
+static struct thread *
+thread_page_get (void)
+{
+  enum intr_level old_level;
+  struct cpu *c;
+  void *page;
+
+  old_level = intr_disable ();
+  c = cpu_current ();
+  page = c->thread_pages;
+  if (page != NULL)
+    {
+      c->thread_pages = *(void **) page;
+      c->thread_page_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (page == NULL)
+    page = palloc_get_page (0);
+  return page;
+}
+
+/* Frees the page of dead thread T, keeping it in CPU C's cache
+   unless the cache already holds thread_cache_max pages.
+   Interrupts must be off. */
+static void
+thread_page_put (struct cpu *c, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Keep stale pointers to T from passing is_thread(). */
+  t->magic = 0;
+
+  if (c->thread_page_cnt < thread_cache_max)
+    {
+      *(void **) t = c->thread_pages;
+      c->thread_pages = t;
+      c->thread_page_cnt++;
+    }
+  else
+    palloc_free_page (t);
+}
+
 /* Schedules a new process.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
@@ -684,29 +2186,54 @@ static void
 schedule (void)
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next = next_thread_to_run (cur->cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  thread_account (cur);
+  next->cpu = cur->cpu;
+  if (cur != next)
+    {
+      uint64_t now = cur->cpu->account_start;
+
+      if (cur->status != THREAD_READY)
+        switches_blocked++;
+      else if (cur->cpu->preempting)
+        switches_preempted++;
+      else
+        switches_yielded++;
+      if (cur->status == THREAD_READY && cur->cpu->preempting)
+        cur->involuntary_switches++;
+      else
+        cur->voluntary_switches++;
+
+      /* Charge NEXT for its wait in the run queue, and start
+         timing CUR in its new state. */
+      next->ready_cycles += now - next->state_start;
+      cur->state_start = now;
+      trace_event (TRACE_SWITCH, cur->status, cur->tid, next->tid);
+    }
+  cur->cpu->preempting = false;
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
 }
 
-/* Returns a tid to use for a new thread. */
+/* Returns a tid to use for a new thread.  The LOCK XADD
+   instruction adds to memory atomically, even across CPUs, and
+   returns the old value, so no lock is needed.  See [IA32-v2b]
+   "XADD". */
 static tid_t
 allocate_tid (void)
 {
   static tid_t next_tid = 1;
-  tid_t tid;
-
-  lock_acquire (&tid_lock);
-  tid = next_tid++;
-  lock_release (&tid_lock);
+  tid_t tid = 1;
 
+  asm volatile ("lock xaddl %0, %1" : "+r" (tid), "+m" (next_tid)
+                : : "memory");
   return tid;
 }
 
@@ -2,9 +2,11 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
-#include <float.h>
+#include <thread-stats.h>
+#include "threads/synch.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -25,6 +27,23 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Default limit on the number of locks a donation is propagated
+   through.  Can be changed with the "-donate-depth=N" option, to
+   any N from 1 to DONATION_DEPTH_MAX. */
+#define DONATION_DEPTH_DEFAULT 8
+#define DONATION_DEPTH_MAX 64
+
+/* Default number of free thread pages that each CPU keeps for
+   reuse.  Can be changed with the "-thread-cache=N" option, to
+   any N from 0 to THREAD_CACHE_MAX. */
+#define THREAD_CACHE_DEFAULT 16
+#define THREAD_CACHE_MAX 1024
+
+/* Default number of ready threads that the MLFQS decay updates
+   each time it takes a run queue lock.  Can be changed with the
+   "-decay-batch=N" option. */
+#define DECAY_BATCH_DEFAULT 8
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -75,12 +94,12 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `heap_elem' member has a dual purpose.  It can be an
+   element in the run queue (thread.c), or it can be an element
+   in a semaphore wait queue (synch.c).  It can be used these two
+   ways only because they are mutually exclusive: only a thread
+   in the ready state is on the run queue, whereas only a thread
+   in the blocked state is on a semaphore wait queue. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -92,12 +111,32 @@ struct thread
     int original_priority;              /* Original Priority. */
     int recent_cpu;                     /* Measure how much CPU time each process has received "recently." */
     int nice;                           /* Nice value that determines how "nice" the thread should be to other threads. */
+    bool fixed_priority;                /* Keeps original_priority under the MLFQS. */
     struct list_elem allelem;           /* List element for all threads list. */
-    struct list locks;                  /* List locks for all locks aquired by that thread.*/
+    struct donor *donors;               /* Max-heap of donors of held locks with waiters. */
     struct lock *waiting;               /* Lock the thread is waiting on and aquired by another thread. */
+    struct rwlock *waiting_rw;          /* Readers-writer lock the thread is waiting on. */
+    struct rw_hold read_holds[RW_READ_MAX]; /* Readers-writer locks held for reading. */
+    uint64_t cpu_cycles;                /* CPU time used, in time-stamp counter cycles. */
+    uint64_t state_start;               /* Cycle count at last change of status. */
+    uint64_t ready_cycles;              /* Cycles spent in THREAD_READY. */
+    uint64_t blocked_cycles;            /* Cycles spent in THREAD_BLOCKED. */
+    uint64_t donated_start;             /* Cycle count when donation began, or 0. */
+    uint64_t donated_cycles;            /* Cycles spent with a donated priority. */
+    unsigned voluntary_switches;        /* # of switches away on blocking or yielding. */
+    unsigned involuntary_switches;      /* # of switches away on preemption. */
+    struct cpu *cpu;                    /* CPU the thread runs or is queued on. */
+    struct fpu_state *fpu;              /* Saved FPU state, or null if never used. */
+    int64_t decay_epoch;                /* MLFQS decays applied to recent_cpu. */
+    int64_t pass;                       /* Stride scheduler pass value. */
+    struct rt_thread *rt;               /* Periodic thread parameters, or null. */
+    struct list_elem elem;              /* Run queue list element. */
 
 	  /* Shared between thread.c and synch.c. */
-    struct list_elem elem;              /* List element. */
+    struct heap_elem heap_elem;         /* Run queue or wait queue element. */
+    struct heap *wait_queue;            /* Semaphore wait queue, or null. */
+    struct heap *cond_queue;            /* Condition wait queue, or null. */
+    struct heap_elem *cond_elem;        /* Element in cond_queue. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -113,15 +152,44 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the stride scheduler, which shares out the CPU in
+   proportion to priority rather than strictly by it.
+   Controlled by kernel command-line option "-stride". */
+extern bool thread_stride;
+
+/* Maximum number of nested locks that a priority donation is
+   propagated through.  Controlled by "-donate-depth=N". */
+extern int thread_donation_depth;
+
+/* Maximum number of free thread pages that each CPU keeps for
+   reuse.  Controlled by "-thread-cache=N". */
+extern int thread_cache_max;
+
+/* Number of ready threads that the MLFQS decay updates each time
+   it takes a run queue lock.  Controlled by "-decay-batch=N". */
+extern int thread_decay_batch;
+
 void thread_init (void);
 void thread_start (void);
+void thread_start_ap (struct cpu *) NO_RETURN;
 bool is_idle_thread(struct thread *t);
 
 void thread_tick (void);
+void thread_ap_tick (void);
+void thread_mlfqs_tick (int64_t ticks);
 void thread_print_stats (void);
+int64_t thread_cpu_time (struct thread *);
+void thread_get_stats (struct thread *, struct thread_stats *);
+
+/* If true, thread_print_stats() prints a table of every thread's
+   accounting, including threads that have exited.  Set by the
+   kernel action "thread-stats". */
+extern bool thread_stats_table;
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_periodic (const char *name, int64_t period,
+                              int64_t budget, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
@@ -132,6 +200,8 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
+void thread_preempt_if_needed (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -139,14 +209,19 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_fix_priority (void);
+void thread_update_priority (struct thread *, int);
+void thread_donate_priority (struct thread *);
+void thread_lock_acquired (struct lock *);
+void thread_lock_released (struct lock *);
+void thread_rwlock_acquired (struct rwlock *, struct thread *);
+void thread_rwlock_released (struct rwlock *);
 
 int ready_queue_length(void);
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 void thread_set_recent_cpu (int);
-void thread_set_load_avg (struct float32);
 int thread_get_load_avg (void);
-struct float32 thread_get_real_load_avg (void);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,150 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A recorded event.  Also the format of each record in a dump,
+   except that the timestamp is converted to nanoseconds. */
+struct trace_record
+  {
+    uint64_t time;              /* Time-stamp counter at the event. */
+    int32_t a, b;               /* Event-specific values. */
+    uint8_t type;               /* An enum trace_type. */
+    uint8_t cpu;                /* CPU the event happened on. */
+    uint8_t arg;                /* Event-specific small value. */
+    uint8_t pad;                /* Unused. */
+  };
+
+/* Number of pages in the ring buffer.  Makes the number of
+   records a power of 2, so that a sequence number maps to a slot
+   with a mask. */
+#define TRACE_PAGES 20
+#define TRACE_CNT (TRACE_PAGES * PGSIZE / sizeof (struct trace_record))
+
+/* Record format version, written in the dump header. */
+#define TRACE_VERSION 1
+
+bool trace_sched;
+
+/* Set by trace_configure(), acted on by trace_init(). */
+static bool sched_requested;
+
+/* Ring buffer and the sequence number of the next record.  A
+   writer claims a slot with one atomic increment, so that
+   recording takes no lock, even across CPUs or from interrupt
+   handlers. */
+static struct trace_record *ring;
+static uint32_t next_seq;
+
+/* Enables the comma-separated trace CLASSES.  Only "sched" is
+   known.  Returns false if CLASSES names any other class.  Takes
+   effect when trace_init() runs. */
+bool
+trace_configure (const char *classes)
+{
+  char buf[64];
+  char *class, *save_ptr;
+
+  if (classes == NULL)
+    return false;
+  strlcpy (buf, classes, sizeof buf);
+  for (class = strtok_r (buf, ",", &save_ptr); class != NULL;
+       class = strtok_r (NULL, ",", &save_ptr))
+    if (!strcmp (class, "sched"))
+      sched_requested = true;
+    else
+      return false;
+  return true;
+}
+
+/* Allocates the ring buffer if tracing was requested.  Must be
+   called after palloc_init(). */
+void
+trace_init (void)
+{
+  ASSERT ((TRACE_CNT & (TRACE_CNT - 1)) == 0);
+
+  if (!sched_requested)
+    return;
+  ring = palloc_get_multiple (0, TRACE_PAGES);
+  if (ring == NULL)
+    {
+      printf ("trace: no memory for %d-page buffer, tracing off\n",
+              TRACE_PAGES);
+      return;
+    }
+  trace_sched = true;
+}
+
+/* Records an event of the given TYPE with values ARG, A, and B.
+   Use trace_event() instead, which checks that tracing is on. */
+void
+trace_log (enum trace_type type, int arg, int a, int b)
+{
+  uint32_t seq = 1;
+  struct trace_record *r;
+
+  asm volatile ("lock xaddl %0, %1" : "+r" (seq), "+m" (next_seq));
+  r = &ring[seq & (TRACE_CNT - 1)];
+  r->time = timer_cycles ();
+  r->a = a;
+  r->b = b;
+  r->type = type;
+  r->cpu = cpu_current ()->id;
+  r->arg = arg;
+  r->pad = 0;
+}
+
+/* Writes the recorded events, oldest first, to the serial port,
+   preceded by a header line:
+
+        PINTOS-TRACE <version> <count> <record size>
+
+   Each record is a struct trace_record in the machine's byte
+   order, with its time in nanoseconds. */
+void
+trace_dump (void)
+{
+  enum intr_level old_level;
+  uint32_t seq, end, cnt;
+  char header[64];
+  const char *p;
+
+  if (!trace_sched)
+    return;
+
+  /* Stop recording while we dump, or new events would overwrite
+     records we have yet to write. */
+  old_level = intr_disable ();
+  trace_sched = false;
+  intr_set_level (old_level);
+
+  end = next_seq;
+  cnt = end < TRACE_CNT ? end : TRACE_CNT;
+  snprintf (header, sizeof header, "PINTOS-TRACE %d %"PRIu32" %zu\n",
+            TRACE_VERSION, cnt, sizeof (struct trace_record));
+  for (p = header; *p != '\0'; p++)
+    serial_putc (*p);
+  for (seq = end - cnt; seq != end; seq++)
+    {
+      struct trace_record r = ring[seq & (TRACE_CNT - 1)];
+      const uint8_t *byte = (const uint8_t *) &r;
+      size_t i;
+
+      r.time = timer_cycles_to_ns (r.time);
+      for (i = 0; i < sizeof r; i++)
+        serial_putc (byte[i]);
+    }
+  serial_putc ('\n');
+  serial_flush ();
+
+  trace_sched = true;
+}
@@ -0,0 +1,41 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+
+/* Scheduler event trace.
+
+   When enabled with the "-trace=sched" kernel option, scheduling
+   events are recorded with time-stamp counter timestamps in a
+   fixed-size ring buffer, overwriting the oldest once it fills.
+   The buffer is written to the serial port at shutdown, or by
+   the "trace-dump" action, for utils/pintos-trace to decode.
+   When tracing is off, each event costs one test of a flag. */
+
+/* Event types.  The meaning of each event's ARG, A, and B. */
+enum trace_type
+  {
+    TRACE_SWITCH,       /* Switch.  ARG: old status, A: old tid, B: new tid. */
+    TRACE_WAKEUP,       /* Unblock.  ARG: priority, A: tid, B: waker's tid. */
+    TRACE_BLOCK,        /* Block.  ARG: priority, A: tid. */
+    TRACE_DONATE,       /* Donation.  ARG: priority, A: holder, B: donor. */
+    TRACE_TIMER         /* Timer expiry.  A: tick it was due. */
+  };
+
+/* True if scheduler events are being recorded. */
+extern bool trace_sched;
+
+bool trace_configure (const char *classes);
+void trace_init (void);
+void trace_log (enum trace_type, int arg, int a, int b);
+void trace_dump (void);
+
+/* Records an event of the given TYPE, if tracing is on. */
+static inline void
+trace_event (enum trace_type type, int arg, int a, int b)
+{
+  if (trace_sched)
+    trace_log (type, arg, a, b);
+}
+
+#endif /* threads/trace.h */
@@ -0,0 +1,225 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Work queues for general use. */
+struct workqueue *system_wq;
+struct workqueue *system_highpri_wq;
+
+static thread_func worker;
+static work_func flush_done;
+static timer_func delayed_work_fire;
+
+/* Creates the system work queues.  Must be called after
+   thread_start(), and before any work is queued on them. */
+void
+workqueue_init (void)
+{
+  system_wq = workqueue_create ("events", PRI_DEFAULT);
+  system_highpri_wq = workqueue_create ("events_highpri", PRI_MAX);
+}
+
+/* Creates and returns a work queue whose work items run in a new
+   kernel thread named NAME at the given PRIORITY.  Panics if
+   memory or the thread cannot be obtained, since kernel work
+   queues are created at boot and never destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int priority)
+{
+  struct workqueue *wq;
+
+  ASSERT (name != NULL);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    PANIC ("workqueue_create: out of memory");
+  list_init (&wq->items);
+  sema_init (&wq->item_cnt, 0);
+  wq->thread = NULL;
+  wq->run_cnt = 0;
+  if (thread_create (name, priority, worker, wq) == TID_ERROR)
+    PANIC ("workqueue_create: cannot create thread %s", name);
+  return wq;
+}
+
+/* Thread function for work queue WQ_, which runs its work items
+   forever. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  wq->thread = thread_current ();
+  thread_fix_priority ();
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w;
+
+      sema_down (&wq->item_cnt);
+      old_level = intr_disable ();
+      w = list_entry (list_pop_front (&wq->items), struct work, elem);
+      w->pending = false;
+      intr_set_level (old_level);
+
+      /* W may be freed or queued again by its own function, so
+         don't touch it afterward. */
+      w->func (w->aux);
+      wq->run_cnt++;
+    }
+}
+
+/* Waits until every work item queued on WQ before the call has
+   run.  Must not be called by WQ's own thread, which would wait
+   for itself forever. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  struct semaphore done;
+  struct work w;
+
+  ASSERT (wq != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (thread_current () != wq->thread);
+
+  sema_init (&done, 0);
+  work_init (&w, flush_done, &done);
+  work_queue (wq, &w);
+  sema_down (&done);
+}
+
+/* Work function for workqueue_flush(). */
+static void
+flush_done (void *done)
+{
+  sema_up (done);
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void)
+{
+  if (system_wq != NULL)
+    printf ("Work queues: %u items run, %u high priority\n",
+            system_wq->run_cnt + system_highpri_wq->run_cnt,
+            system_highpri_wq->run_cnt);
+}
+
+/* Initializes W as a work item that calls FUNC, passing AUX. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->wq = NULL;
+  w->pending = false;
+}
+
+/* Queues W on WQ.  Returns true if successful, false if W was
+   already queued and has not yet started, in which case it will
+   run only once.  An item that is already running may be queued
+   again.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (w->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  w->pending = true;
+  w->wq = wq;
+  list_push_back (&wq->items, &w->elem);
+  intr_set_level (old_level);
+
+  sema_up (&wq->item_cnt);
+  return true;
+}
+
+/* Waits until W, if it was last queued on a work queue, has
+   finished running, along with the items queued ahead of it. */
+void
+work_flush (struct work *w)
+{
+  ASSERT (w != NULL);
+
+  if (w->wq != NULL)
+    workqueue_flush (w->wq);
+}
+
+/* Initializes DW as a delayed work item that calls FUNC, passing
+   AUX. */
+void
+delayed_work_init (struct delayed_work *dw, work_func *func, void *aux)
+{
+  ASSERT (dw != NULL);
+
+  work_init (&dw->work, func, aux);
+  dw->timer.pending = false;
+}
+
+/* Queues DW on WQ once TICKS timer ticks have passed, or right
+   away if TICKS is not positive.  Returns true if successful,
+   false if DW is already waiting for its timer or in a queue.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue_delayed (struct workqueue *wq, struct delayed_work *dw,
+                    int64_t ticks)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (wq != NULL);
+  ASSERT (dw != NULL);
+
+  if (ticks <= 0)
+    return work_queue (wq, &dw->work);
+
+  old_level = intr_disable ();
+  success = !dw->timer.pending && !dw->work.pending;
+  if (success)
+    {
+      dw->work.wq = wq;
+      timer_add (&dw->timer, timer_ticks () + ticks, delayed_work_fire, dw);
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Timer function that queues delayed work item DW_. */
+static void
+delayed_work_fire (void *dw_)
+{
+  struct delayed_work *dw = dw_;
+
+  work_queue (dw->work.wq, &dw->work);
+}
+
+/* Stops DW's timer.  Returns true if DW was waiting for its timer
+   and now will not run, false if it had already been queued, in
+   which case it runs as usual.
+
+   This function may be called from an interrupt handler. */
+bool
+delayed_work_cancel (struct delayed_work *dw)
+{
+  ASSERT (dw != NULL);
+
+  return timer_cancel (&dw->timer);
+}
@@ -0,0 +1,74 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "threads/synch.h"
+
+/* Deferred work.
+
+   An interrupt handler runs with interrupts off, so everything it
+   does adds to the interrupt latency of the whole system.  A
+   handler should do only what cannot wait, and put the rest in a
+   work item that it queues on a work queue.  Each work queue has
+   a kernel thread that runs the items queued on it one at a time,
+   in the order they were queued, with interrupts on.  The thread
+   keeps its priority even under the MLFQS.  A work item may
+   sleep, but that holds up every item behind it in the same
+   queue.
+
+   Work items are owned by the caller, which must keep them alive
+   until they have run. */
+
+/* Called by a work queue's thread to do a work item's work,
+   passing along AUX. */
+typedef void work_func (void *aux);
+
+/* A work item. */
+struct work
+  {
+    struct list_elem elem;      /* Element in work queue. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    struct workqueue *wq;       /* Queue last queued on, or null. */
+    bool pending;               /* Queued but not yet started? */
+  };
+
+/* A work item that is queued once a timer expires. */
+struct delayed_work
+  {
+    struct work work;           /* The work item. */
+    struct timer_elem timer;    /* Queues WORK when it fires. */
+  };
+
+/* A work queue. */
+struct workqueue
+  {
+    struct list items;          /* Queued work items, oldest first. */
+    struct semaphore item_cnt;  /* Number of items in ITEMS. */
+    struct thread *thread;      /* Runs the work items. */
+    unsigned run_cnt;           /* # of work items run. */
+  };
+
+/* Work queues for general use, one at PRI_DEFAULT and one at
+   PRI_MAX. */
+extern struct workqueue *system_wq;
+extern struct workqueue *system_highpri_wq;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int priority);
+void workqueue_flush (struct workqueue *);
+void workqueue_print_stats (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct workqueue *, struct work *);
+void work_flush (struct work *);
+
+void delayed_work_init (struct delayed_work *, work_func *, void *aux);
+bool work_queue_delayed (struct workqueue *, struct delayed_work *,
+                         int64_t ticks);
+bool delayed_work_cancel (struct delayed_work *);
+
+#endif /* threads/workqueue.h */
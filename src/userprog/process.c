@@ -396,8 +396,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
+      /* Get a page of memory.  A page that is all zeros, as in
+         the BSS, may come already zeroed. */
+      enum palloc_flags flags = PAL_USER;
+      uint8_t *kpage;
+      if (page_zero_bytes == PGSIZE)
+        flags |= PAL_ZERO;
+      kpage = palloc_get_page (flags);
       if (kpage == NULL)
         return false;
 
@@ -407,7 +412,8 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
+      if (!(flags & PAL_ZERO))
+        memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
       /* Add the page to the process's address space. */
       if (!install_page (upage, kpage, writable)) 
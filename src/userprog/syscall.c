@@ -1,10 +1,18 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/futex.h"
+#include "userprog/pagedir.h"
 
 static void syscall_handler (struct intr_frame *);
+static bool user_range_ok (const void *, size_t, bool writable);
+static bool sys_thread_stats (struct thread_stats *);
+static int sys_futex_wait (int *, int expected, int timeout_ms);
+static int sys_futex_wake (int *, int cnt);
 
 void
 syscall_init (void) 
@@ -13,8 +21,106 @@ syscall_init (void)
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
+  uint32_t *args = f->esp;
+
+  /* The system call number, then its arguments, are on the user
+     stack. */
+  if (user_range_ok (args, sizeof *args, false))
+    switch (args[0])
+      {
+      case SYS_THREAD_STATS:
+        if (!user_range_ok (args, 2 * sizeof *args, false))
+          break;
+        f->eax = sys_thread_stats ((struct thread_stats *) args[1]);
+        return;
+      case SYS_FUTEX_WAIT:
+        if (!user_range_ok (args, 4 * sizeof *args, false))
+          break;
+        f->eax = sys_futex_wait ((int *) args[1], args[2], args[3]);
+        return;
+      case SYS_FUTEX_WAKE:
+        if (!user_range_ok (args, 3 * sizeof *args, false))
+          break;
+        f->eax = sys_futex_wake ((int *) args[1], args[2]);
+        return;
+      }
+
   printf ("system call!\n");
   thread_exit ();
 }
+
+/* Returns true if the SIZE bytes starting at user address UADDR
+   are all mapped in the running process's address space, and
+   also writable if WRITABLE is true.  The kernel must check
+   before writing to a user page, because a write to a read-only
+   page faults even in kernel mode. */
+static bool
+user_range_ok (const void *uaddr, size_t size, bool writable)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  const uint8_t *p = uaddr;
+  const uint8_t *end = p + size;
+
+  if (size == 0)
+    return true;
+  if (end < p || !is_user_vaddr (end - 1))
+    return false;
+  for (p = pg_round_down (p); p < end; p += PGSIZE)
+    if (writable ? !pagedir_is_writable (pd, p)
+        : pagedir_get_page (pd, p) == NULL)
+      return false;
+  return true;
+}
+
+/* Copies the running thread's CPU accounting to user buffer
+   STATS.  Returns false if STATS is not a valid buffer. */
+static bool
+sys_thread_stats (struct thread_stats *stats)
+{
+  struct thread_stats s;
+
+  if (!user_range_ok (stats, sizeof *stats, true))
+    return false;
+  thread_get_stats (thread_current (), &s);
+  memcpy (stats, &s, sizeof s);
+  return true;
+}
+
+/* Returns the kernel alias of the futex at user address UADDR,
+   which identifies its physical page and offset, or a null
+   pointer if UADDR is misaligned or not mapped. */
+static int *
+user_futex (int *uaddr)
+{
+  uint8_t *kpage;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+    return NULL;
+  kpage = pagedir_get_page (thread_current ()->pagedir, pg_round_down (uaddr));
+  if (kpage == NULL)
+    return NULL;
+  return (int *) (kpage + pg_ofs (uaddr));
+}
+
+/* Waits on the futex at user address UADDR.  See futex_wait().
+   Returns FUTEX_FAULT if UADDR is not a valid futex address. */
+static int
+sys_futex_wait (int *uaddr, int expected, int timeout_ms)
+{
+  int *futex = user_futex (uaddr);
+
+  return futex != NULL ? futex_wait (futex, expected, timeout_ms) : FUTEX_FAULT;
+}
+
+/* Wakes threads waiting on the futex at user address UADDR.  See
+   futex_wake().  Returns FUTEX_FAULT if UADDR is not a valid futex
+   address. */
+static int
+sys_futex_wake (int *uaddr, int cnt)
+{
+  int *futex = user_futex (uaddr);
+
+  return futex != NULL ? futex_wake (futex, cnt) : FUTEX_FAULT;
+}